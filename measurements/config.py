@@ -8,7 +8,9 @@ from typing import Literal
 
 path = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
 src_path = f"{path}/src"
-FilterType = Literal["no", "basic", "blocked"]
+FilterType = Literal[
+    "no", "basic", "blocked", "register", "sectorized", "cuckoo", "xor", "auto"
+]
 
 
 @dataclass
@@ -32,6 +34,16 @@ class JoinConfig:
     bloom_hashes: int = None
     bloom_size: int = None
     bloom_block_size: int = None
+    bloom_placement: Literal["global", "local"] = None
+    bloom_bypass: float = None
+    bloom_replicate: bool = None
+    bloom_save: str = None
+    bloom_load: str = None
+    bloom_semi_join: bool = None
+    bloom_prefilter_size: int = None
+    bloom_prefilter_hashes: int = None
+    bloom_hash: Literal["crapwow", "crc", "murmur", "mulshift"] = None
+    bloom_prune: bool = None
 
     def toDict(self):
         return {key: value for key, value in self.getArgs()}
@@ -58,6 +70,12 @@ class JoinConfig:
             boolArgs += ["--full-range"]
         if self.non_unique:
             boolArgs += ["--non-unique"]
+        if self.bloom_replicate:
+            boolArgs += ["--bloom-replicate"]
+        if self.bloom_semi_join:
+            boolArgs += ["--bloom-semi-join"]
+        if self.bloom_prune:
+            boolArgs += ["--bloom-prune"]
         return boolArgs
 
     def getArgsString(self):
@@ -116,6 +116,39 @@ def parse_result(res: str) -> dict:
         filtered = filtered.group(1)
     else:
         filtered = None
+    removed_r = re.search("R-tuples removed by semi-join filter: (\d+)\n", res)
+    pruned_s = re.search("S-tuples pruned by partition ranges: (\d+)", res)
+    join_tasks = re.search(
+        "JOIN-TASKS \(coalesced below \d+ tuples\): (\d+) partition pairs in "
+        "(\d+) tasks",
+        res,
+    )
+    pass2_bits = re.search(
+        "PASS2-RADIXBITS \((?:fixed|partitions of R up to \d+ tuples)\):((?: \d+:\d+)+)",
+        res,
+    )
+    tiers = re.search(
+        "FILTER-TIERS \(\d+, \d+ bits\): tier-1 passed \d+ of \d+ \(([\d.]+)\), "
+        "tier-2 passed \d+ of \d+ \(([\d.]+)\)",
+        res,
+    )
+    health = re.search(
+        "FILTER-HEALTH \(m = \d+, k = \d+\): (?:\d+ false positives of \d+ "
+        "negatives, )?empirical FPR ([\d.]+|n/a)%?, theoretical FPR ([\d.]+)%"
+        "(?:, fill ratio ([\d.]+))?(?:, slot occupancy ([\d.]+))?",
+        res,
+    )
+    filter_access = re.search(
+        "FILTER-ADD, FILTER-CONTAINS \(cycles per thread, with histogram\):"
+        "\W+(\d+)\W+(\d+)",
+        res,
+    )
+    filter_build = re.search(
+        "FILTER-BUILD, FILTER-MERGE \(cycles, [\w-]+ build\):\W+(\d+)\W+(\d+)", res
+    )
+    filter_replicate = re.search(
+        "FILTER-REPLICATE \(cycles, \d+ replicas\):\W+(\d+)", res
+    )
     [runtime_cycles, build_cycles, part_cycles] = re.search(
         "RUNTIME TOTAL, BUILD, PART \(cycles\):\W+(\d+)\W+(\d+)\W+(\d+)", res
     ).groups()
@@ -131,6 +164,25 @@ def parse_result(res: str) -> dict:
     data = {
         "filtered": int(filtered) if filtered else None,
         "filtered-pct": int(filtered) / s_size * 100 if filtered else None,
+        "removed-r": int(removed_r.group(1)) if removed_r else None,
+        "pruned-s": int(pruned_s.group(1)) if pruned_s else None,
+        "join-pairs": int(join_tasks.group(1)) if join_tasks else None,
+        "join-tasks": int(join_tasks.group(2)) if join_tasks else None,
+        "pass2-radixbits": pass2_bits.group(1).strip() if pass2_bits else None,
+        "tier1-pass-rate": float(tiers.group(1)) if tiers else None,
+        "tier2-pass-rate": float(tiers.group(2)) if tiers else None,
+        "empirical-fpr": float(health.group(1))
+        if health and health.group(1) != "n/a"
+        else None,
+        "theoretical-fpr": float(health.group(2)) if health else None,
+        "fill-ratio": float(health.group(3)) if health and health.group(3) else None,
+        "slot-occupancy": float(health.group(4))
+        if health and health.group(4)
+        else None,
+        "filter-add-cycles": int(filter_access.group(1)) if filter_access else None,
+        "filter-contains-cycles": int(filter_access.group(2))
+        if filter_access
+        else None,
         "runtime-cycles": int(runtime_cycles),
         "build-cycles": int(build_cycles),
         "part-cycles": int(part_cycles),
@@ -140,6 +192,11 @@ def parse_result(res: str) -> dict:
         "partition-usecs": float(partition_usecs),
         "probe-usecs": float(probe_usecs),
         "join-usecs": float(join_usecs),
+        "filter-build-cycles": int(filter_build.group(1)) if filter_build else None,
+        "filter-merge-cycles": int(filter_build.group(2)) if filter_build else None,
+        "filter-replicate-cycles": int(filter_replicate.group(1))
+        if filter_replicate
+        else None,
     }
 
     if "Counter" in res:
@@ -161,7 +218,7 @@ def best_hash_function(seed=1337):
     ranks them by speed and collisions.
     This should show that CRC and CrapWow are performing best or at least comparable to
     the best 2 hash functions. If not, evaluation should make use of the best hash
-    functions, which requires manual action in the `bloom_filter.c` code.
+    functions with `bloom_hash`, mulshift_batch is the vectorized multiply-shift.
     This function prints details about:
 
     1. speed (per hash)
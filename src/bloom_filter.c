@@ -1,18 +1,65 @@
-#if defined(__i386__) || defined(__x86_64__)
-#include <immintrin.h>
-#else
-#include "sse2neon.h"
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
 #endif
+#include <fcntl.h>
 #include <math.h>
-#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "bloom_filter.h"
+#include "bloom_filter_kernels.h"
+#include "cpu_mapping.h"
 #include "hash.h"
 #include "prj_params.h"
 
+#define MAX(X, Y) (((X) > (Y)) ? (X) : (Y))
+
+/** offset of the bitmap in a saved filter, so it can be mapped page-aligned */
+#define BLOOM_FILE_OFFSET 4096
+
+/** header of a filter saved by bloom_filter_save */
+typedef struct bloom_file_header_t {
+    char     magic[8];
+    uint32_t key_size; /* sizeof(intkey_t), the hashes depend on it */
+    uint32_t variant;
+    uint64_t m;
+    uint64_t k;
+    uint64_t B;
+    uint64_t nblocks;
+    uint32_t seed;
+    uint32_t overflow;
+    int64_t  min_key;
+    uint32_t hash; /* 0 (crapwow) in files saved before it was added */
+} bloom_file_header_t;
+
+static const char bloom_file_magic[8] = "BLOOMFLT";
+
+/*
+ * Cost model of bloom_filter_tune in ns per tuple. A filter access is
+ * amortized by the prefetching of contains_batch.
+ */
+#ifndef TUNE_ACCESS_L2
+#define TUNE_ACCESS_L2 1.0
+#endif
+#ifndef TUNE_ACCESS_LLC
+#define TUNE_ACCESS_LLC 4.0
+#endif
+#ifndef TUNE_ACCESS_DRAM
+#define TUNE_ACCESS_DRAM 12.0
+#endif
+/** computing and testing one bit of a key */
+#ifndef TUNE_BIT
+#define TUNE_BIT 0.4
+#endif
+/** a tuple passing the filter: scatter in pass-1, pass-2 and probe */
+#ifndef TUNE_PASS
+#define TUNE_PASS 8.0
+#endif
+
 static inline void
 assert(bool cond, char * msg)
 {
@@ -25,16 +72,166 @@ assert(bool cond, char * msg)
 void
 assert_args(bloom_filter_args_t * args)
 {
-    assert((args->m & (args->m - 1)) == 0, "m must be a power of 2");
+    /* blocked filters use fast range reduction for the block index */
+    if (args->variant == BASIC || args->variant == CUCKOO) {
+        assert((args->m & (args->m - 1)) == 0, "m must be a power of 2");
+    }
 
-    if (args->variant != BASIC) {
+    if (args->variant == REGISTER_BLOCKED) {
+        assert(args->m >= 64 && args->m % 64 == 0,
+               "m must be a multiple of 64 (one register)");
+    } else if (args->variant == SECTORIZED) {
+        assert(args->m >= SECTORIZED_BLOCK_BITS
+                   && args->m % SECTORIZED_BLOCK_BITS == 0,
+               "m must be a multiple of 512 (one cache line)");
+    } else if (args->variant == XOR) {
+        assert(!args->local_build, "xor filters cannot be built thread-locally");
+    } else if (args->variant == EXACT && args->local_build) {
+        assert(false, "exact filters cannot be built thread-locally");
+    } else if (args->variant == CUCKOO) {
+        assert(args->m >= 64, "m must be at least 64 (one bucket)");
+        assert(!args->local_build,
+               "cuckoo filters cannot be built thread-locally");
+    } else if (args->variant != BASIC) {
         assert(pow(2, (int) log2(args->B)) == args->B, "B must be a power 2");
-        assert(args->m % args->B == 0, "m must be a multiple of B");
+        assert(args->m >= args->B && args->m % args->B == 0,
+               "m must be a multiple of B");
+    }
+    /* the first tier is a register-blocked filter */
+    if (args->prefilter_m) {
+        assert(args->prefilter_m % 64 == 0,
+               "the first tier must be a multiple of 64 bits");
+        assert(args->prefilter_k > 0, "the first tier needs k > 0");
     }
 }
 
+/* FPR of a basic filter with m bits, k hash functions and n keys */
+static double
+fpr_basic(double m, double k, double n)
+{
+    return pow(1 - exp(-k * n / m), k);
+}
+
+/* FPR of a blocked filter, the number of keys per block is Poisson distributed */
+static double
+fpr_blocked(double m, double B, double k, double n)
+{
+    double lambda = n * B / m;
+    double spread = 10 * sqrt(lambda) + 10;
+    double fpr    = 0;
+
+    for (double l = fmax(0, floor(lambda - spread)); l < lambda + spread; l++) {
+        double p = exp(-lambda + l * log(lambda) - lgamma(l + 1));
+        fpr += p * fpr_basic(B, k, l);
+    }
+    return fpr;
+}
+
+/* FPR of a sectorized filter: a key sets floor(k / 8) bits in each sector of
+   its block and one more in k % 8 of them, a sector has 64 bits */
+static double
+fpr_sectorized(double m, double k, double n)
+{
+    const double S      = SECTORS_PER_BLOCK;
+    const double keep   = pow(1 - 1 / 64.0, floor(k / S))
+                        * (1 - fmod(k, S) / S / 64);
+    double       lambda = n * SECTORIZED_BLOCK_BITS / m;
+    double       spread = 10 * sqrt(lambda) + 10;
+    double       fpr    = 0;
+
+    for (double l = fmax(0, floor(lambda - spread)); l < lambda + spread; l++) {
+        double p = exp(-lambda + l * log(lambda) - lgamma(l + 1));
+        fpr += p * pow(1 - pow(keep, l), k);
+    }
+    return fpr;
+}
+
+/* predicted cost in ns of a random access to a filter of m bits */
+static double
+tune_access_cost(uint64_t m, long l2, long llc)
+{
+    /* the filter has to share the caches with the partitions */
+    return m / 8 <= l2 / 2    ? TUNE_ACCESS_L2
+           : m / 8 <= llc / 2 ? TUNE_ACCESS_LLC
+                              : TUNE_ACCESS_DRAM;
+}
+
+bool
+bloom_filter_tune(bloom_filter_args_t * args, uint64_t r_size, uint64_t s_size,
+                  double selectivity)
+{
+    static const char * names[] = {"basic", "blocked", "register",
+                                   "sectorized"};
+    static const struct {
+        bloom_filter_variant_t variant;
+        uint64_t               B;
+        double                 bit_cost; /* relative cost per hash function */
+    } variants[] = {{BLOCKED, 256, 1.0},
+                    {BLOCKED, 512, 1.0},
+                    {BLOCKED, 1024, 1.0},
+                    {REGISTER_BLOCKED, 64, 0.5},
+                    {SECTORIZED, SECTORIZED_BLOCK_BITS, 0.5}};
+
+    long l2  = get_cache_size(2);
+    long llc = get_cache_size(3);
+    l2       = l2 > 0 ? l2 : L2_CACHE_SIZE;
+    llc      = llc > 0 ? llc : LLC_CACHE_SIZE;
+
+    /* filter sizes: bits per key and the sizes that fit into L2 and LLC */
+    uint64_t sizes[] = {r_size,     2 * r_size,  4 * r_size, 8 * r_size,
+                        16 * r_size, 32 * r_size, l2 * 4,     llc * 4};
+
+    /* without a filter, every tuple of S is partitioned and probed */
+    double no_filter = s_size * TUNE_PASS;
+    double best      = no_filter;
+    double best_fpr  = 1;
+
+    for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v++) {
+        const uint64_t B = variants[v].B;
+
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            const uint64_t m      = MAX(sizes[i] / B * B, B);
+            const double   access = tune_access_cost(m, l2, llc);
+
+            for (uint64_t k = 1; k <= 8; k++) {
+                double hash = TUNE_BIT * variants[v].bit_cost * k;
+                double fpr  = variants[v].variant == SECTORIZED
+                                  ? fpr_sectorized(m, k, r_size)
+                                  : fpr_blocked(m, B, k, r_size);
+                double pass = selectivity + (1 - selectivity) * fpr;
+                double cost = (r_size + s_size) * (access + hash)
+                              + s_size * pass * TUNE_PASS;
+
+                if (cost < best) {
+                    best          = cost;
+                    best_fpr      = fpr;
+                    args->variant = variants[v].variant;
+                    args->B       = B;
+                    args->m       = m;
+                    args->k       = k;
+                }
+            }
+        }
+    }
+
+    fprintf(stdout, "[INFO ] Bloom filter auto-tuning (L2 = %ld KiB, LLC = %ld "
+                    "KiB): ",
+            l2 >> 10, llc >> 10);
+    if (best >= no_filter) {
+        fprintf(stdout, "no filter (predicted %.1f ms)\n", no_filter / 1e6);
+        return false;
+    }
+    fprintf(stdout,
+            "-b %s -m %lu -k %lu -B %lu, predicted FPR = %.4f%%, "
+            "predicted %.1f ms (%.1f ms without filter)\n",
+            names[args->variant], args->m, args->k, args->B, best_fpr * 100,
+            best / 1e6, no_filter / 1e6);
+    return true;
+}
+
+/* the pages are only placed on a NUMA node by the first thread touching them */
 static void *
-calloc_aligned(size_t size)
+alloc_aligned(size_t size)
 {
     void * ret;
     int    rv;
@@ -44,102 +241,503 @@ calloc_aligned(size_t size)
         perror("alloc_aligned() failed: out of memory");
         return 0;
     }
-    memset(ret, 0, size);
 
     return ret;
 }
 
-/**
- * @brief Compute mod_m for m which is a power of 2, i.e. m = 2^x
- *
- * @param val the value to be taken modulo
- * @param m the modulo operant, must be a power of 2
- * @return the resulting value in the range of 0 to m-1
- */
-static inline uint32_t
-mod_m(uint32_t val, uint64_t m)
+static void *
+calloc_aligned(size_t size)
 {
-    return val & (m - 1);
+    void * ret = alloc_aligned(size);
+
+    if (ret) memset(ret, 0, size);
+    return ret;
 }
 
-/**
- * @brief generic method to add a key to a filter
- *
- * @param filter the filter to add the key to
- * @param key the key to add
- * @param bitmap the bitmap to set the bits in, separated to support blocked filters
- * @param size the size of the filter, separated to support blocked filters
- */
 void
-add_generic(const bloom_filter_t * filter, const intkey_t key,
-            unsigned char * bitmap, uint32_t size)
+add_basic(const bloom_filter_t * filter, const intkey_t key)
 {
-    uint32_t h = hash_crapwow(filter->seed, key);
-    uint32_t y = key + filter->seed;
+    bloom_add_bits(filter, key, filter->bitmap, filter->m, filter->k);
+}
 
-    h = mod_m(h, size);
-    y = mod_m(y, size);
+bool
+contains_basic(const bloom_filter_t * filter, const intkey_t key)
+{
+    return bloom_test_bits(filter, key, filter->bitmap, filter->m, filter->k);
+}
 
-    for (int i = 0; i < filter->k; i++) {
-        atomic_fetch_or_explicit(bitmap + (h >> 3), 1 << (h & 7),
-                                 memory_order_relaxed);
-        h = mod_m(h + y, size);
-        y = mod_m(y + i + 1, size);
-    }
+/* the byte of the first bit, most negatives are rejected by it */
+static inline const void *
+locate_basic(const bloom_filter_t * filter, const intkey_t key)
+{
+    uint32_t h = mod_m(bloom_hash_bits(filter, key), filter->m);
+    return filter->bitmap + (h >> 3);
+}
+
+static inline bool
+test_basic(const bloom_filter_t * filter, const intkey_t key, const void * addr)
+{
+    return contains_basic(filter, key);
+}
+
+static inline unsigned char *
+locate_blocked(const bloom_filter_t * filter, const intkey_t key)
+{
+    return filter->bitmap
+           + bloom_block_idx(filter, key, filter->nblocks) * (filter->B / 8);
+}
+
+static inline bool
+test_blocked(const bloom_filter_t * filter, const intkey_t key,
+             const void * block)
+{
+    return bloom_test_bits(filter, key, block, filter->B, filter->k);
+}
+
+void
+add_blocked(const bloom_filter_t * filter, const intkey_t key)
+{
+    bloom_add_bits(filter, key, locate_blocked(filter, key), filter->B,
+                   filter->k);
+}
+
+bool
+contains_blocked(const bloom_filter_t * filter, const intkey_t key)
+{
+    return test_blocked(filter, key, locate_blocked(filter, key));
+}
+
+static inline uint64_t *
+locate_register_blocked(const bloom_filter_t * filter, const intkey_t key)
+{
+    return (uint64_t *) filter->bitmap
+           + bloom_block_idx(filter, key, filter->nblocks);
+}
+
+static inline bool
+test_register_blocked(const bloom_filter_t * filter, const intkey_t key,
+                      const void * block)
+{
+    uint64_t mask = bloom_register_mask(filter, key, filter->k);
+    return (*(const uint64_t *) block & mask) == mask;
+}
+
+void
+add_register_blocked(const bloom_filter_t * filter, const intkey_t key)
+{
+    atomic_fetch_or_explicit(locate_register_blocked(filter, key),
+                             bloom_register_mask(filter, key, filter->k),
+                             memory_order_relaxed);
 }
 
-// separate bitmap and size from filter param to simultaneously support basic and blocked filter
 bool
-contains_generic(const bloom_filter_t * filter, const intkey_t key,
-                 const unsigned char * bitmap, uint32_t size)
+contains_register_blocked(const bloom_filter_t * filter, const intkey_t key)
+{
+    return test_register_blocked(filter, key,
+                                 locate_register_blocked(filter, key));
+}
+
+static inline uint64_t *
+locate_sectorized(const bloom_filter_t * filter, const intkey_t key)
 {
-    uint32_t h = hash_crapwow(filter->seed, key);
-    uint32_t y = key + filter->seed;
+    return (uint64_t *) filter->bitmap
+           + bloom_block_idx(filter, key, filter->nblocks)
+                 * SECTORS_PER_BLOCK;
+}
+
+void
+add_sectorized(const bloom_filter_t * filter, const intkey_t key)
+{
+    uint64_t mask[SECTORS_PER_BLOCK];
 
-    h = mod_m(h, size);
-    y = mod_m(y, size);
+    bloom_sectorized_mask(filter, key, filter->k, mask);
+    bloom_sectorized_add(locate_sectorized(filter, key), mask);
+}
 
-    for (int i = 0; i < filter->k; i++) {
-        if (!(bitmap[h >> 3] & (1 << (h & 7)))) {
-            return false;
+static inline bool
+test_sectorized(const bloom_filter_t * filter, const intkey_t key,
+                const void * block)
+{
+    return bloom_sectorized_test(filter, key, filter->k, block);
+}
+
+bool
+contains_sectorized(const bloom_filter_t * filter, const intkey_t key)
+{
+    return test_sectorized(filter, key, locate_sectorized(filter, key));
+}
+
+/*
+ * Cuckoo filter with CUCKOO_BUCKET_SLOTS fingerprints per 64-bit bucket and
+ * two candidate buckets per key (partial-key cuckoo hashing): the alternate
+ * bucket is derived from the bucket and the fingerprint only, so fingerprints
+ * can be relocated without knowing their key. A lookup touches at most two
+ * words, independent of the FPR. Empty slots are 0, fingerprints are never 0.
+ */
+
+#define CUCKOO_LANES_LO 0x0001000100010001ULL
+#define CUCKOO_LANES_HI 0x8000800080008000ULL
+
+static inline uint64_t
+cuckoo_fingerprint(const bloom_filter_t * filter, const intkey_t key)
+{
+    uint64_t fp = bloom_hash_bits(filter, key)
+                  & ((1 << CUCKOO_FINGERPRINT_BITS) - 1);
+    return fp ? fp : 1;
+}
+
+static inline uint64_t
+cuckoo_alt_bucket(const bloom_filter_t * filter, uint64_t bucket, uint64_t fp)
+{
+    return (bucket ^ (fp * 0x5bd1e995)) & (filter->nblocks - 1);
+}
+
+/* bit 16*i+15 is set for the lowest fingerprint slot i that is 0 */
+static inline uint64_t
+cuckoo_zero_slots(uint64_t bucket)
+{
+    return (bucket - CUCKOO_LANES_LO) & ~bucket & CUCKOO_LANES_HI;
+}
+
+static inline bool
+cuckoo_bucket_has(uint64_t bucket, uint64_t fp)
+{
+    return cuckoo_zero_slots(bucket ^ (fp * CUCKOO_LANES_LO)) != 0;
+}
+
+/* atomically puts fp into an empty slot of the bucket */
+static inline bool
+cuckoo_bucket_insert(uint64_t * bucket, uint64_t fp)
+{
+    uint64_t old = __atomic_load_n(bucket, __ATOMIC_RELAXED);
+    uint64_t empty;
+
+    while ((empty = cuckoo_zero_slots(old))) {
+        uint64_t shift = __builtin_ctzll(empty) + 1 - CUCKOO_FINGERPRINT_BITS;
+        if (__atomic_compare_exchange_n(bucket, &old, old | (fp << shift),
+                                        false, __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED)) {
+            return true;
         }
+    }
+    return false;
+}
 
-        h = mod_m(h + y, size);
-        y = mod_m(y + i + 1, size);
+/* number of slots that hold a fingerprint */
+static uint64_t
+cuckoo_occupied_slots(const bloom_filter_t * filter)
+{
+    const uint64_t * buckets = (const uint64_t *) filter->bitmap;
+    uint64_t         slots   = 0;
+
+    for (uint64_t i = 0; i < filter->nblocks; i++) {
+        for (int s = 0; s < CUCKOO_BUCKET_SLOTS; s++) {
+            slots += (buckets[i] >> (s * CUCKOO_FINGERPRINT_BITS)
+                      & ((1 << CUCKOO_FINGERPRINT_BITS) - 1))
+                     != 0;
+        }
     }
-    return true;
+    return slots;
+}
+
+static inline const uint64_t *
+locate_cuckoo(const bloom_filter_t * filter, const intkey_t key)
+{
+    const uint64_t * buckets = (const uint64_t *) filter->bitmap;
+    uint64_t         i1 = bloom_block_idx(filter, key, filter->nblocks);
+
+    __builtin_prefetch(
+        buckets + cuckoo_alt_bucket(filter, i1, cuckoo_fingerprint(filter, key)),
+        0, 3);
+    return buckets + i1;
+}
+
+static inline bool
+test_cuckoo(const bloom_filter_t * filter, const intkey_t key,
+            const void * bucket)
+{
+    const uint64_t * buckets = (const uint64_t *) filter->bitmap;
+    uint64_t         fp      = cuckoo_fingerprint(filter, key);
+    uint64_t         i1      = (const uint64_t *) bucket - buckets;
+
+    return cuckoo_bucket_has(*(const uint64_t *) bucket, fp)
+           || cuckoo_bucket_has(buckets[cuckoo_alt_bucket(filter, i1, fp)], fp)
+           || filter->overflow;
 }
 
 void
-add_basic(const bloom_filter_t * filter, const intkey_t key)
+add_cuckoo(const bloom_filter_t * filter, const intkey_t key)
 {
-    add_generic(filter, key, filter->bitmap, filter->m);
+    uint64_t * buckets = (uint64_t *) filter->bitmap;
+    uint64_t   fp      = cuckoo_fingerprint(filter, key);
+    uint64_t   i       = bloom_block_idx(filter, key, filter->nblocks);
+
+    /* every lookup passes anyway */
+    if (filter->overflow) return;
+    if (cuckoo_bucket_insert(buckets + i, fp)) return;
+    i = cuckoo_alt_bucket(filter, i, fp);
+
+    /* both buckets are full: evict fingerprints to their alternate bucket */
+    for (int kick = 0; kick < CUCKOO_MAX_KICKS; kick++) {
+        if (cuckoo_bucket_insert(buckets + i, fp)) return;
+
+        uint64_t shift = ((fp + kick) % CUCKOO_BUCKET_SLOTS)
+                         * CUCKOO_FINGERPRINT_BITS;
+        uint64_t lane  = ((1ULL << CUCKOO_FINGERPRINT_BITS) - 1) << shift;
+        uint64_t old   = __atomic_load_n(buckets + i, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(buckets + i, &old,
+                                            (old & ~lane) | (fp << shift), false,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            ;
+        fp = (old & lane) >> shift;
+        i  = cuckoo_alt_bucket(filter, i, fp);
+    }
+
+    /* the fingerprint in hand cannot be placed, lookups must not miss it */
+    if (!__atomic_exchange_n((uint32_t *) &filter->overflow, 1,
+                             __ATOMIC_RELAXED)) {
+        fprintf(stderr, "[WARN ] cuckoo filter is full, increase -m\n");
+    }
 }
 
 bool
-contains_basic(const bloom_filter_t * filter, const intkey_t key)
+contains_cuckoo(const bloom_filter_t * filter, const intkey_t key)
 {
-    return contains_generic(filter, key, filter->bitmap, filter->m);
+    return test_cuckoo(filter, key, locate_cuckoo(filter, key));
 }
 
-void
-add_blocked(const bloom_filter_t * filter, const intkey_t key)
+/*
+ * Static xor filter (Graf and Lemire) with 8-bit fingerprints. A key maps to
+ * one slot in each of three segments of nblocks slots and the xor of the three
+ * slots equals the fingerprint of the key. It needs XOR_SLOTS_PER_KEY * 8 bits
+ * per key for an FPR of 2^-8 and exactly three accesses per lookup, but it can
+ * only be built at once from all keys.
+ */
+
+static inline uint64_t
+xor_hash(uint32_t seed, const intkey_t key)
+{
+    /* murmur3 finalizer, a bijection so distinct keys never collide */
+    uint64_t h = (uint64_t) key + seed * 0x9e3779b97f4a7c15ULL;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static inline uint8_t
+xor_fingerprint(uint64_t h)
+{
+    return (uint8_t) (h ^ (h >> 32));
+}
+
+/* the slot of hash h in segment i, uses a multiply instead of a modulo */
+static inline uint64_t
+xor_slot(uint64_t h, int i, uint64_t seglen)
+{
+    uint64_t r = i ? (h << (21 * i)) | (h >> (64 - 21 * i)) : h;
+    return (((uint64_t) (uint32_t) r * seglen) >> 32) + i * seglen;
+}
+
+static inline const uint8_t *
+locate_xor(const bloom_filter_t * filter, const intkey_t key)
 {
-    uint32_t block_idx    = mod_m(hash_crc(filter->seed, key), filter->nblocks);
-    unsigned char * block = filter->bitmap + block_idx * (filter->B / 8);
+    uint64_t h = xor_hash(filter->seed, key);
 
-    add_generic(filter, key, block, filter->B);
+    __builtin_prefetch(filter->bitmap + xor_slot(h, 1, filter->nblocks), 0, 3);
+    __builtin_prefetch(filter->bitmap + xor_slot(h, 2, filter->nblocks), 0, 3);
+    return filter->bitmap + xor_slot(h, 0, filter->nblocks);
+}
+
+static inline bool
+test_xor(const bloom_filter_t * filter, const intkey_t key, const void * slot)
+{
+    const uint8_t * fp = filter->bitmap;
+    uint64_t        h  = xor_hash(filter->seed, key);
+
+    return xor_fingerprint(h)
+           == (*(const uint8_t *) slot ^ fp[xor_slot(h, 1, filter->nblocks)]
+               ^ fp[xor_slot(h, 2, filter->nblocks)]);
 }
 
 bool
-contains_blocked(const bloom_filter_t * filter, const intkey_t key)
+contains_xor(const bloom_filter_t * filter, const intkey_t key)
 {
-    uint32_t block_idx    = mod_m(hash_crc(filter->seed, key), filter->nblocks);
-    unsigned char * block = filter->bitmap + block_idx * (filter->B / 8);
+    return test_xor(filter, key, locate_xor(filter, key));
+}
 
-    return contains_generic(filter, key, block, filter->B);
+static int
+compare_hash(const void * a, const void * b)
+{
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
 }
 
+/**
+ * Assigns the fingerprints of the (distinct) hashes by peeling: a slot that
+ * only one hash maps to is removed with its hash until all hashes are
+ * removed, then the slots are assigned in reverse order.
+ *
+ * @return false if the hashes cannot be peeled with the current seed
+ */
+static bool
+xor_construct(bloom_filter_t * filter, const uint64_t * hashes, uint64_t n)
+{
+    const uint64_t seglen = filter->nblocks;
+    const uint64_t nslots = 3 * seglen;
+    uint8_t *      fp     = filter->bitmap;
+
+    uint64_t * xormask = calloc(nslots, sizeof(uint64_t));
+    uint32_t * count   = calloc(nslots, sizeof(uint32_t));
+    uint64_t * queue   = malloc(nslots * sizeof(uint64_t));
+    uint64_t * stack_h = malloc(n * sizeof(uint64_t));
+    uint64_t * stack_s = malloc(n * sizeof(uint64_t));
+    uint64_t   nqueue = 0, nstack = 0;
+
+    for (uint64_t j = 0; j < n; j++) {
+        for (int i = 0; i < 3; i++) {
+            uint64_t s = xor_slot(hashes[j], i, seglen);
+            xormask[s] ^= hashes[j];
+            count[s]++;
+        }
+    }
+    /* every slot becomes a singleton at most once, so nslots is enough */
+    for (uint64_t s = 0; s < nslots; s++) {
+        if (count[s] == 1) queue[nqueue++] = s;
+    }
+    while (nqueue) {
+        uint64_t s = queue[--nqueue];
+        if (count[s] != 1) continue;
+
+        uint64_t h        = xormask[s];
+        stack_h[nstack]   = h;
+        stack_s[nstack++] = s;
+        for (int i = 0; i < 3; i++) {
+            uint64_t t = xor_slot(h, i, seglen);
+            xormask[t] ^= h;
+            if (--count[t] == 1) queue[nqueue++] = t;
+        }
+    }
+
+    bool ok = nstack == n;
+    if (ok) {
+        memset(fp, 0, nslots);
+        while (nstack--) {
+            uint64_t h = stack_h[nstack], s = stack_s[nstack];
+            fp[s]      = 0;
+            fp[s]      = xor_fingerprint(h) ^ fp[xor_slot(h, 0, seglen)]
+                    ^ fp[xor_slot(h, 1, seglen)] ^ fp[xor_slot(h, 2, seglen)];
+        }
+    }
+
+    free(stack_s);
+    free(stack_h);
+    free(queue);
+    free(count);
+    free(xormask);
+    return ok;
+}
+
+void
+build_xor(bloom_filter_t * filter, const tuple_t * tuples, uint64_t n)
+{
+    const uint64_t seglen = (uint64_t) (XOR_SLOTS_PER_KEY * n + 32) / 3 + 1;
+    uint64_t *     hashes = malloc(n * sizeof(uint64_t));
+    bool           dedup  = false;
+
+    /* the bitmap is reused if it is large enough */
+    if (3 * seglen > filter->m / 8) {
+        free(filter->bitmap);
+        filter->m      = ((3 * seglen + CACHE_LINE_SIZE - 1)
+                     & ~(uint64_t) (CACHE_LINE_SIZE - 1))
+                    * 8;
+        filter->bitmap = calloc_aligned(filter->m / 8);
+    }
+    filter->nblocks = seglen;
+
+    while (true) {
+        uint64_t nkeys = n;
+        for (uint64_t j = 0; j < n; j++) {
+            hashes[j] = xor_hash(filter->seed, tuples[j].key);
+        }
+        /* duplicate keys cannot be peeled, they are only removed on demand */
+        if (dedup) {
+            qsort(hashes, n, sizeof(uint64_t), compare_hash);
+            nkeys = 0;
+            for (uint64_t j = 0; j < n; j++) {
+                if (nkeys == 0 || hashes[j] != hashes[nkeys - 1])
+                    hashes[nkeys++] = hashes[j];
+            }
+        }
+        if (xor_construct(filter, hashes, nkeys)) break;
+
+        dedup = true;
+        filter->seed++;
+    }
+    free(hashes);
+}
+
+/* position of the key in the range of an exact filter, keys below the range
+   wrap around to positions beyond it */
+static inline uint64_t
+exact_bit(const bloom_filter_t * filter, const intkey_t key)
+{
+    return (uint64_t) key - (uint64_t) filter->min_key;
+}
+
+static inline const uint64_t *
+locate_exact(const bloom_filter_t * filter, const intkey_t key)
+{
+    uint64_t bit = exact_bit(filter, key);
+    /* keys out of the range are rejected by test_exact */
+    return (const uint64_t *) filter->bitmap + (bit < filter->m ? bit >> 6 : 0);
+}
+
+static inline bool
+test_exact(const bloom_filter_t * filter, const intkey_t key,
+           const void * word)
+{
+    uint64_t bit = exact_bit(filter, key);
+    return bit < filter->m && (*(const uint64_t *) word >> (bit & 63) & 1);
+}
+
+void
+add_exact(const bloom_filter_t * filter, const intkey_t key)
+{
+    uint64_t bit = exact_bit(filter, key);
+    atomic_fetch_or_explicit((uint64_t *) filter->bitmap + (bit >> 6),
+                             (uint64_t) 1 << (bit & 63), memory_order_relaxed);
+}
+
+bool
+contains_exact(const bloom_filter_t * filter, const intkey_t key)
+{
+    return test_exact(filter, key, locate_exact(filter, key));
+}
+
+// clang-format off
+/** defines the batched contains of a variant, see BLOOM_CONTAINS_BATCH_BODY */
+#define DEFINE_CONTAINS_BATCH(NAME, LOCATE, TEST)                       \
+    uint64_t                                                            \
+    NAME(const bloom_filter_t * filter, const tuple_t * tuples,         \
+         uint32_t n, uint64_t * sel)                                    \
+    {                                                                   \
+        BLOOM_CONTAINS_BATCH_BODY(LOCATE, TEST)                         \
+    }
+// clang-format on
+
+DEFINE_CONTAINS_BATCH(contains_batch_basic, locate_basic, test_basic)
+DEFINE_CONTAINS_BATCH(contains_batch_blocked, locate_blocked, test_blocked)
+DEFINE_CONTAINS_BATCH(contains_batch_register_blocked, locate_register_blocked,
+                      test_register_blocked)
+DEFINE_CONTAINS_BATCH(contains_batch_sectorized, locate_sectorized,
+                      test_sectorized)
+DEFINE_CONTAINS_BATCH(contains_batch_cuckoo, locate_cuckoo, test_cuckoo)
+DEFINE_CONTAINS_BATCH(contains_batch_xor, locate_xor, test_xor)
+DEFINE_CONTAINS_BATCH(contains_batch_exact, locate_exact, test_exact)
+
 bloom_filter_strategy_t *
 bloom_filter_create(bloom_filter_args_t * args, uint32_t seed)
 {
@@ -147,33 +745,497 @@ bloom_filter_create(bloom_filter_args_t * args, uint32_t seed)
     bloom_filter_t *          filter   = malloc(sizeof(bloom_filter_t));
 
     filter->variant = args->variant;
-    filter->m       = args->m;
+    /* sized by build, or by the key range for an exact filter */
+    filter->m       = args->variant == XOR || args->variant == EXACT ? 0
+                                                                     : args->m;
     filter->k       = args->k;
-    filter->B       = args->B;
-    filter->nblocks = args->m / args->B;
-    filter->seed    = seed;
-    filter->bitmap  = calloc_aligned(args->m / 8);
+    filter->B       = args->variant == REGISTER_BLOCKED ? 64
+                      : args->variant == CUCKOO        ? 64
+                      : args->variant == XOR           ? 8
+                      : args->variant == SECTORIZED    ? SECTORIZED_BLOCK_BITS
+                                                       : args->B;
+    filter->nblocks = filter->m / filter->B;
+    filter->seed     = seed;
+    filter->overflow = 0;
+    filter->mapped   = 0;
+    filter->min_key  = 0;
+    filter->max_m    = args->m;
+    filter->lazy_clear = args->lazy_clear;
+    filter->hash       = args->hash;
+    filter->bitmap     = !filter->m        ? NULL
+                         : args->lazy_clear ? alloc_aligned(filter->m / 8)
+                                            : calloc_aligned(filter->m / 8);
 
     strategy->variant = args->variant;
     strategy->filter  = filter;
+    strategy->build   = NULL;
 
     switch (args->variant) {
         case BASIC:
-            strategy->add      = add_basic;
-            strategy->contains = contains_basic;
+            strategy->add            = add_basic;
+            strategy->contains       = contains_basic;
+            strategy->contains_batch = contains_batch_basic;
             break;
         case BLOCKED:
-            strategy->add      = add_blocked;
-            strategy->contains = contains_blocked;
+            strategy->add            = add_blocked;
+            strategy->contains       = contains_blocked;
+            strategy->contains_batch = contains_batch_blocked;
+            break;
+        case REGISTER_BLOCKED:
+            strategy->add            = add_register_blocked;
+            strategy->contains       = contains_register_blocked;
+            strategy->contains_batch = contains_batch_register_blocked;
+            break;
+        case SECTORIZED:
+            strategy->add            = add_sectorized;
+            strategy->contains       = contains_sectorized;
+            strategy->contains_batch = contains_batch_sectorized;
+            break;
+        case CUCKOO:
+            strategy->add            = add_cuckoo;
+            strategy->contains       = contains_cuckoo;
+            strategy->contains_batch = contains_batch_cuckoo;
+            break;
+        case XOR:
+            strategy->add            = NULL;
+            strategy->contains       = contains_xor;
+            strategy->contains_batch = contains_batch_xor;
+            strategy->build          = build_xor;
+            break;
+        case EXACT:
+            strategy->add            = add_exact;
+            strategy->contains       = contains_exact;
+            strategy->contains_batch = contains_batch_exact;
             break;
     }
+
+    strategy->prefilter = NULL;
+    if (args->prefilter_m) {
+        bloom_filter_args_t pre_args = {.variant = REGISTER_BLOCKED,
+                                        .m       = args->prefilter_m,
+                                        .k       = args->prefilter_k,
+                                        .B       = 64,
+                                        .hash    = args->hash};
+        /* another seed, so both tiers do not fail on the same keys */
+        strategy->prefilter = bloom_filter_create(&pre_args, seed ^ 0x5bd1e995);
+    }
+    return strategy;
+}
+
+bloom_filter_strategy_t *
+bloom_filter_create_like(const bloom_filter_strategy_t * other)
+{
+    const bloom_filter_t * pre  = other->prefilter ? other->prefilter->filter
+                                                   : NULL;
+    bloom_filter_args_t    args = {.variant     = other->filter->variant,
+                                .m           = other->filter->variant == EXACT
+                                                   ? other->filter->max_m
+                                                   : other->filter->m,
+                                .k           = other->filter->k,
+                                .B           = other->filter->B,
+                                .prefilter_m = pre ? pre->m : 0,
+                                .prefilter_k = pre ? pre->k : 0,
+                                .local_build = false,
+                                .placement   = PASS1_GLOBAL,
+                                .bypass_threshold = 1.0,
+                                .replicate   = false,
+                                .save_path   = NULL,
+                                .load_path   = NULL,
+                                .semi_join   = false,
+                                .lazy_clear  = false,
+                                .hash        = other->filter->hash,
+                                .prune       = false,
+                                .adaptive_pass2 = false};
+
+    return bloom_filter_create(&args, other->filter->seed);
+}
+
+bloom_filter_strategy_t *
+bloom_filter_replicate(const bloom_filter_strategy_t * other)
+{
+    bloom_filter_strategy_t * replica = bloom_filter_create_like(other);
+    bloom_filter_t *          filter  = replica->filter;
+
+    /* a static filter is only sized by its build */
+    if (!filter->bitmap) {
+        filter->bitmap = calloc_aligned(other->filter->m / 8);
+    }
+    filter->m        = other->filter->m;
+    filter->nblocks  = other->filter->nblocks;
+    filter->seed     = other->filter->seed;
+    filter->overflow = other->filter->overflow;
+    filter->min_key  = other->filter->min_key;
+    memcpy(filter->bitmap, other->filter->bitmap, filter->m / 8);
+    if (other->prefilter) {
+        memcpy(replica->prefilter->filter->bitmap,
+               other->prefilter->filter->bitmap,
+               other->prefilter->filter->m / 8);
+    }
+
+    return replica;
+}
+
+void
+bloom_filter_insert(bloom_filter_strategy_t * strategy, const tuple_t * tuples,
+                    uint64_t n)
+{
+    const bloom_filter_strategy_t * pre = strategy->prefilter;
+
+    for (uint64_t i = 0; i < n; i++) {
+        strategy->add(strategy->filter, tuples[i].key);
+    }
+    for (uint64_t i = 0; pre && i < n; i++) {
+        pre->add(pre->filter, tuples[i].key);
+    }
+}
+
+bool
+bloom_filter_exact_init(bloom_filter_strategy_t * strategy, intkey_t min,
+                        intkey_t max)
+{
+    bloom_filter_t * filter = strategy->filter;
+    const uint64_t   span   = (uint64_t) max - (uint64_t) min;
+    /* the full range of 8-byte keys has 2^64 keys, it saturates */
+    const uint64_t range = min > max           ? 0
+                           : span < UINT64_MAX ? span + 1
+                                               : UINT64_MAX;
+
+    if (range > filter->max_m) {
+        bloom_filter_args_t       args = {.variant    = BLOCKED,
+                                          .m          = filter->max_m,
+                                          .k          = filter->k,
+                                          .B          = filter->B,
+                                          .lazy_clear = filter->lazy_clear,
+                                          .hash       = filter->hash};
+        bloom_filter_strategy_t * fallback = bloom_filter_create(&args,
+                                                                 filter->seed);
+
+        printf("Key range of %lu is wider than m, using a blocked filter\n",
+               range);
+        fallback->prefilter = strategy->prefilter;
+        free(filter->bitmap);
+        free(filter);
+        *strategy = *fallback;
+        free(fallback);
+        return false;
+    }
+
+    /* whole cache lines, bits beyond the range stay 0 */
+    const uint64_t m = (range + CACHE_LINE_SIZE * 8 - 1)
+                       & ~(uint64_t) (CACHE_LINE_SIZE * 8 - 1);
+
+    /* the bitmap is reused if it is large enough */
+    if (m > filter->m) {
+        free(filter->bitmap);
+        filter->m      = m;
+        filter->bitmap = filter->lazy_clear ? alloc_aligned(m / 8)
+                                            : calloc_aligned(m / 8);
+    } else if (filter->bitmap && !filter->lazy_clear) {
+        memset(filter->bitmap, 0, filter->m / 8);
+    }
+    filter->nblocks = filter->m / 64;
+    filter->min_key = min;
+    return true;
+}
+
+void
+bloom_filter_build(bloom_filter_strategy_t * strategy, const tuple_t * tuples,
+                   uint64_t n)
+{
+    bloom_filter_strategy_t * pre = strategy->prefilter;
+
+    if (pre) bloom_filter_reset(pre);
+    if (strategy->variant != EXACT) {
+        strategy->build(strategy->filter, tuples, n);
+        for (uint64_t i = 0; pre && i < n; i++) {
+            pre->add(pre->filter, tuples[i].key);
+        }
+        return;
+    }
+
+    intkey_t min = n ? tuples[0].key : 1, max = n ? tuples[0].key : 0;
+    for (uint64_t i = 1; i < n; i++) {
+        min = tuples[i].key < min ? tuples[i].key : min;
+        max = tuples[i].key > max ? tuples[i].key : max;
+    }
+    bloom_filter_exact_init(strategy, min, max);
+    if (strategy->filter->lazy_clear) bloom_filter_reset(strategy);
+    bloom_filter_insert(strategy, tuples, n);
+}
+
+void
+bloom_filter_reset(bloom_filter_strategy_t * strategy)
+{
+    bloom_filter_reset_range(strategy, 0, strategy->filter->m / 8);
+}
+
+void
+bloom_filter_reset_range(bloom_filter_strategy_t * strategy, uint64_t from,
+                         uint64_t to)
+{
+    bloom_filter_t * filter = strategy->filter;
+
+    /* an exact filter has no bitmap before its key range is set */
+    if (filter->bitmap && from < to) {
+        memset(filter->bitmap + from, 0, to - from);
+    }
+    if (from == 0) filter->overflow = 0;
+
+    /* the ranges of the first tier scaled like this tile it as well */
+    if (strategy->prefilter) {
+        const uint64_t nbytes   = filter->m / 8;
+        const uint64_t prebytes = strategy->prefilter->filter->m / 8;
+
+        bloom_filter_reset_range(strategy->prefilter,
+                                 nbytes ? from * prebytes / nbytes : 0,
+                                 nbytes ? to * prebytes / nbytes : prebytes);
+    }
+}
+
+void
+bloom_filter_merge(bloom_filter_strategy_t * dst,
+                   bloom_filter_strategy_t * const * srcs, int nsrcs,
+                   uint64_t from, uint64_t to)
+{
+    unsigned char * restrict bitmap = dst->filter->bitmap;
+
+    for (int s = 0; s < nsrcs; s++) {
+        const unsigned char * restrict src = srcs[s]->filter->bitmap;
+        for (uint64_t i = from; i < to; i++) {
+            bitmap[i] |= src[i];
+        }
+    }
+
+    /* the ranges of the first tier scaled like this tile it as well */
+    if (dst->prefilter) {
+        const uint64_t            nbytes    = dst->filter->m / 8;
+        const uint64_t            prebytes  = dst->prefilter->filter->m / 8;
+        bloom_filter_strategy_t * pres[nsrcs];
+
+        for (int s = 0; s < nsrcs; s++) {
+            pres[s] = srcs[s]->prefilter;
+        }
+        bloom_filter_merge(dst->prefilter, pres, nsrcs,
+                           from * prebytes / nbytes, to * prebytes / nbytes);
+    }
+}
+
+uint64_t
+bloom_filter_popcount(const bloom_filter_t * filter, uint64_t from,
+                      uint64_t to)
+{
+    const unsigned char * bitmap = filter->bitmap;
+    uint64_t              bits   = 0;
+
+    for (; from + 8 <= to; from += 8) {
+        uint64_t word;
+        memcpy(&word, bitmap + from, sizeof(word));
+        bits += __builtin_popcountll(word);
+    }
+    for (; from < to; from++) {
+        bits += __builtin_popcount(bitmap[from]);
+    }
+    return bits;
+}
+
+double
+bloom_filter_expected_fpr(const bloom_filter_strategy_t * strategy, uint64_t n)
+{
+    const bloom_filter_t * filter = strategy->filter;
+    double                 fpr;
+
+    switch (filter->variant) {
+        case BASIC:
+            fpr = fpr_basic(filter->m, filter->k, n);
+            break;
+        case CUCKOO:
+            /* both buckets hold up to CUCKOO_BUCKET_SLOTS fingerprints, every
+               key passes a filter that overflowed */
+            if (filter->overflow) {
+                fpr = 1;
+                break;
+            }
+            fpr = 1
+                  - pow(1 - pow(2, -CUCKOO_FINGERPRINT_BITS),
+                        2.0 * fmin(n, filter->m / CUCKOO_FINGERPRINT_BITS)
+                            / (filter->m / 64));
+            break;
+        case XOR:
+            fpr = pow(2, -8);
+            break;
+        case EXACT:
+            fpr = 0;
+            break;
+        case SECTORIZED:
+            fpr = fpr_sectorized(filter->m, filter->k, n);
+            break;
+        default:
+            fpr = fpr_blocked(filter->m, filter->B, filter->k, n);
+    }
+    /* the hashes of the first tier are independent of the second */
+    if (strategy->prefilter) {
+        fpr *= bloom_filter_expected_fpr(strategy->prefilter, n);
+    }
+    return fpr;
+}
+
+void
+bloom_filter_print_health(const bloom_filter_strategy_t * strategy,
+                          uint64_t nkeys, uint64_t checked, uint64_t passed,
+                          uint64_t matched, uint64_t bits)
+{
+    const bloom_filter_t * filter = strategy->filter;
+
+    fprintf(stdout, "FILTER-HEALTH (m = %lu, k = %lu): ", filter->m, filter->k);
+    if (checked) {
+        const uint64_t fp        = passed > matched ? passed - matched : 0;
+        const uint64_t negatives = checked > matched ? checked - matched : 0;
+        fprintf(stdout,
+                "%lu false positives of %lu negatives, empirical FPR %.4f%%, ",
+                fp, negatives, negatives ? fp * 100.0 / negatives : 0);
+    } else {
+        fprintf(stdout, "empirical FPR n/a, ");
+    }
+    fprintf(stdout, "theoretical FPR %.4f%%",
+            bloom_filter_expected_fpr(strategy, nkeys) * 100);
+    /* the bits of fingerprint filters are no fill ratio, for a cuckoo filter
+       the share of occupied slots is printed instead, for xor nothing */
+    if (bits && filter->variant == CUCKOO) {
+        fprintf(stdout, ", slot occupancy %.4f",
+                cuckoo_occupied_slots(filter)
+                    / (double) (filter->nblocks * CUCKOO_BUCKET_SLOTS));
+    } else if (bits && filter->variant != XOR) {
+        fprintf(stdout, ", fill ratio %.4f", bits / (double) filter->m);
+    }
+    fprintf(stdout, "\n");
+}
+
+int
+bloom_filter_save(const bloom_filter_strategy_t * strategy, const char * path)
+{
+    const bloom_filter_t * filter = strategy->filter;
+    bloom_file_header_t    header = {.key_size = sizeof(intkey_t),
+                                     .variant  = filter->variant,
+                                     .m        = filter->m,
+                                     .k        = filter->k,
+                                     .B        = filter->B,
+                                     .nblocks  = filter->nblocks,
+                                     .seed     = filter->seed,
+                                     .overflow = filter->overflow,
+                                     .min_key  = filter->min_key,
+                                     .hash     = filter->hash};
+    FILE *                 file   = fopen(path, "wb");
+
+    if (!file) {
+        perror("bloom_filter_save() failed to open the file");
+        return -1;
+    }
+    memcpy(header.magic, bloom_file_magic, sizeof(header.magic));
+    if (fwrite(&header, sizeof(header), 1, file) != 1
+        || fseek(file, BLOOM_FILE_OFFSET, SEEK_SET)
+        || fwrite(filter->bitmap, 1, filter->m / 8, file) != filter->m / 8) {
+        perror("bloom_filter_save() failed to write the filter");
+        fclose(file);
+        return -1;
+    }
+    return fclose(file) ? -1 : 0;
+}
+
+/** prints an error and returns false if a loaded parameter does not match */
+static bool
+load_matches(const char * path, const char * name, uint64_t loaded,
+             uint64_t expected)
+{
+    if (loaded != expected) {
+        fprintf(stderr, "[ERROR] filter in %s has %s = %lu, expected %lu\n",
+                path, name, loaded, expected);
+    }
+    return loaded == expected;
+}
+
+bloom_filter_strategy_t *
+bloom_filter_load(bloom_filter_args_t * args, const char * path)
+{
+    bloom_file_header_t header;
+    int                 fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+        perror("bloom_filter_load() failed to open the file");
+        return NULL;
+    }
+    if (read(fd, &header, sizeof(header)) != sizeof(header)
+        || memcmp(header.magic, bloom_file_magic, sizeof(header.magic))) {
+        fprintf(stderr, "[ERROR] %s is not a saved filter\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    /* an empty filter of the requested parameters, m is set from the file */
+    bloom_filter_args_t       like     = *args;
+    bloom_filter_strategy_t * strategy = NULL;
+    like.m                             = 0;
+    like.prefilter_m                   = 0; /* R is not inserted again */
+    like.lazy_clear                    = false;
+    strategy                           = bloom_filter_create(&like, header.seed);
+    bloom_filter_t * filter            = strategy->filter;
+
+    /* the size of a static filter is chosen by its build */
+    if (!load_matches(path, "key size", header.key_size, sizeof(intkey_t))
+        || !load_matches(path, "variant", header.variant, filter->variant)
+        || (filter->variant != XOR && filter->variant != EXACT
+            && !load_matches(path, "m", header.m, args->m))
+        || !load_matches(path, "k", header.k, filter->k)
+        || !load_matches(path, "B", header.B, filter->B)
+        || !load_matches(path, "hash", header.hash, filter->hash)) {
+        close(fd);
+        bloom_filter_destroy(strategy);
+        return NULL;
+    }
+
+    /* a truncated file would only fault when a probe reaches its end */
+    const uint64_t length = BLOOM_FILE_OFFSET + header.m / 8;
+    struct stat    st      = {0};
+    if (fstat(fd, &st) || (uint64_t) st.st_size < length) {
+        fprintf(stderr,
+                "[ERROR] filter in %s is truncated, it has %ld of %lu bytes\n",
+                path, (long) st.st_size, length);
+        close(fd);
+        bloom_filter_destroy(strategy);
+        return NULL;
+    }
+    unsigned char * map = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("bloom_filter_load() failed to map the file");
+        bloom_filter_destroy(strategy);
+        return NULL;
+    }
+    /* best effort: huge pages are only used if the kernel supports them for
+       the file system, the probes of S then miss the TLB less often */
+#ifdef MADV_HUGEPAGE
+    madvise(map, length, MADV_HUGEPAGE);
+#endif
+    madvise(map, length, MADV_WILLNEED);
+
+    filter->bitmap   = map + BLOOM_FILE_OFFSET;
+    filter->mapped   = length;
+    filter->m        = header.m;
+    filter->nblocks  = header.nblocks;
+    filter->overflow = header.overflow;
+    filter->min_key  = header.min_key;
     return strategy;
 }
 
 void
 bloom_filter_destroy(bloom_filter_strategy_t * strategy)
 {
-    free(strategy->filter->bitmap);
+    if (strategy->filter->mapped) {
+        munmap(strategy->filter->bitmap - BLOOM_FILE_OFFSET,
+               strategy->filter->mapped);
+    } else {
+        free(strategy->filter->bitmap);
+    }
+    if (strategy->prefilter) bloom_filter_destroy(strategy->prefilter);
     free(strategy->filter);
     free(strategy);
 }
@@ -7,7 +7,44 @@
 #include "lock.h"
 #include "types.h"
 
-typedef enum { BASIC, BLOCKED } bloom_filter_variant_t;
+typedef enum {
+    BASIC,
+    BLOCKED,
+    REGISTER_BLOCKED,
+    SECTORIZED,
+    CUCKOO,
+    XOR,
+    EXACT
+} bloom_filter_variant_t;
+
+/**
+ * hash family of the filters. crapwow selects the bits with crapwow and the
+ * block with crc, the others use one function with two seeds for both. The
+ * xor filter always uses its own 64-bit hash.
+ */
+typedef enum {
+    HASH_CRAPWOW,
+    HASH_CRC,
+    HASH_MURMUR,
+    HASH_MULSHIFT
+} bloom_filter_hash_t;
+
+/** block size of the sectorized filter: one cache line */
+#define SECTORIZED_BLOCK_BITS 512
+/** number of 64-bit sectors per sectorized block */
+#define SECTORS_PER_BLOCK (SECTORIZED_BLOCK_BITS / 64)
+
+/** fingerprint size of the cuckoo filter in bits */
+#define CUCKOO_FINGERPRINT_BITS 16
+/** fingerprints per cuckoo bucket, a bucket is one 64-bit word */
+#define CUCKOO_BUCKET_SLOTS (64 / CUCKOO_FINGERPRINT_BITS)
+/** number of relocations before an insert into the cuckoo filter fails */
+#ifndef CUCKOO_MAX_KICKS
+#define CUCKOO_MAX_KICKS 512
+#endif
+
+/** slots of the xor filter per key, the slots hold 8-bit fingerprints */
+#define XOR_SLOTS_PER_KEY 1.23
 
 typedef struct bloom_filter_t {
     bloom_filter_variant_t variant; /* the type of filter */
@@ -17,6 +54,12 @@ typedef struct bloom_filter_t {
     uint64_t               k; /* number of hash functions to use */
     uint64_t               B; /* block size in bits (must be multiple of 8) */
     uint64_t               nblocks; /* number of blocks in filter (m/B) */
+    uint32_t overflow; /* cuckoo: an insert failed, every lookup passes */
+    uint64_t mapped;   /* length of the file mapping of a loaded filter */
+    intkey_t min_key;  /* exact: the key of the first bit */
+    uint64_t max_m;    /* exact: widest key range before falling back to m */
+    bool lazy_clear; /* the bitmap is cleared by bloom_filter_reset_range */
+    bloom_filter_hash_t hash; /* hash family of the bits and blocks */
 } bloom_filter_t;
 
 /**
@@ -40,18 +83,119 @@ typedef void (*bloom_filter_add_strategy_t)(const bloom_filter_t * filter,
 typedef bool (*bloom_filter_contains_strategy_t)(const bloom_filter_t * filter,
                                                  const intkey_t         key);
 
+/**
+ * @brief checks a batch of tuples against the bloom filter. The filter words
+ * or blocks of a group of keys are located and prefetched before the keys are
+ * tested, so the cache misses of a group overlap (group prefetching).
+ *
+ * @param filter The filter to be checked
+ * @param tuples The tuples whose keys are checked
+ * @param n number of tuples in the batch
+ * @param sel [in/out] selection bitmap where bit i belongs to tuples[i]. Only
+ * selected tuples are checked and tuples that are definitely not present get
+ * deselected. Bits at positions >= n must be cleared.
+ * @return the number of selected tuples after the check
+ */
+typedef uint64_t (*bloom_filter_contains_batch_strategy_t)(
+    const bloom_filter_t * filter, const tuple_t * tuples, uint32_t n,
+    uint64_t * sel);
+
+/**
+ * @brief builds a static filter at once from all keys of a relation. The
+ * filter is sized for the keys, previous contents are discarded.
+ *
+ * @param filter the filter to build
+ * @param tuples the tuples whose keys are inserted
+ * @param n the number of tuples
+ */
+typedef void (*bloom_filter_build_strategy_t)(bloom_filter_t *  filter,
+                                              const tuple_t * tuples,
+                                              uint64_t        n);
+
 typedef struct bloom_filter_strategy_t {
-    bloom_filter_variant_t           variant;
-    bloom_filter_t *                 filter;
-    bloom_filter_add_strategy_t      add;
-    bloom_filter_contains_strategy_t contains;
+    bloom_filter_variant_t                 variant;
+    bloom_filter_t *                       filter;
+    bloom_filter_add_strategy_t            add; /* NULL for static filters */
+    bloom_filter_contains_strategy_t       contains;
+    bloom_filter_contains_batch_strategy_t contains_batch;
+    bloom_filter_build_strategy_t          build; /* static filters only */
+    /** small first tier that keys are checked against before the filter */
+    struct bloom_filter_strategy_t * prefilter;
 } bloom_filter_strategy_t;
 
+/** static filters are built once with build and do not support add, an
+ *  exact filter is static until its key range is set */
+static inline bool
+bloom_filter_is_static(const bloom_filter_strategy_t * strategy)
+{
+    return strategy->build != NULL || strategy->variant == EXACT;
+}
+
+/** number of keys that are located and prefetched together in a batch */
+#ifndef BLOOM_PREFETCH_GROUP
+#define BLOOM_PREFETCH_GROUP 16
+#endif
+
+/** number of tuples per call of contains_batch in the partitioning loops,
+ *  must be a multiple of 64 */
+#ifndef BLOOM_BATCH_TUPLES
+#define BLOOM_BATCH_TUPLES 4096
+#endif
+
+/** number of tuples per thread that are checked to decide on the adaptive
+ *  bypass of the filter, must be a multiple of 64 */
+#ifndef BLOOM_BYPASS_SAMPLE_TUPLES
+#define BLOOM_BYPASS_SAMPLE_TUPLES (16 * BLOOM_BATCH_TUPLES)
+#endif
+
+/** number of 64-bit words of a selection bitmap for N tuples */
+#define BLOOM_SEL_WORDS(N) (((N) + 63) / 64)
+
+/** checks whether tuple I is selected in the selection bitmap SEL */
+#define BLOOM_SELECTED(SEL, I) (((SEL)[(I) >> 6] >> ((I) &63)) & 1)
+
+/**
+ * @brief selects the first n tuples in a selection bitmap, all other bits of
+ * the last word are cleared
+ *
+ * @param sel the selection bitmap of at least BLOOM_SEL_WORDS(n) words
+ * @param n the number of tuples to select
+ */
+static inline void
+bloom_selection_fill(uint64_t * sel, uint64_t n)
+{
+    for (uint64_t w = 0; w < n / 64; w++) {
+        sel[w] = ~0ULL;
+    }
+    if (n % 64) {
+        sel[n / 64] = (1ULL << (n % 64)) - 1;
+    }
+}
+
+/**
+ * where S is checked: against one filter for all of R in pass-1 or against
+ * small, cache-resident filters of the partitions of R in pass-2
+ */
+typedef enum { PASS1_GLOBAL, PASS2_LOCAL } bloom_filter_placement_t;
+
 typedef struct bloom_filter_args_t {
     bloom_filter_variant_t variant; /* the type of filter */
     uint64_t               m; /* filter size in bits (must be multiple of 8) */
     uint64_t               k; /* number of hash functions to use */
     uint64_t               B; /* block size in bits (must be multiple of 8) */
+    bool local_build; /* threads build private filters that are merged */
+    bloom_filter_placement_t placement; /* global pass-1 or local pass-2 */
+    double bypass_threshold; /* stop checking above this pass rate, 1: never */
+    bool   replicate; /* probe a copy of the global filter on each NUMA node */
+    const char * save_path; /* file the built filter is saved to, or NULL */
+    const char * load_path; /* file of a filter built by an earlier run */
+    bool semi_join; /* drop R-tuples in pass-2 with a filter of S from pass-1 */
+    uint64_t prefilter_m; /* bits of the cache-resident first tier, 0: none */
+    uint64_t prefilter_k; /* bits per key of the first tier */
+    bool lazy_clear; /* leave the bitmap to bloom_filter_reset_range */
+    bloom_filter_hash_t hash; /* hash family of the bits and blocks */
+    bool prune; /* drop S-tuples outside the key range of their R partition */
+    bool adaptive_pass2; /* pass-2 radix bits per pass-1 partition by size */
 } bloom_filter_args_t;
 
 typedef enum { INSERT, CHECK, IGNORE } bloom_filter_usage_t;
@@ -76,7 +220,192 @@ bloom_filter_create(bloom_filter_args_t * args, uint32_t seed);
 void
 bloom_filter_destroy(bloom_filter_strategy_t * bloom_filter_strategy);
 
+/**
+ * @brief Creates an empty filter with the same parameters and seed as another
+ * filter, i.e. keys are mapped to the same bits. Used for thread-local builds
+ * that are merged into the shared filter with bloom_filter_merge.
+ *
+ * @param other the filter whose parameters are used
+ * @return the empty filter
+ */
+bloom_filter_strategy_t *
+bloom_filter_create_like(const bloom_filter_strategy_t * other);
+
+/**
+ * @brief Inserts the keys of the tuples into the filter and its first tier.
+ *
+ * @param strategy the filter to insert into
+ * @param tuples the tuples whose keys are inserted
+ * @param n the number of tuples
+ */
+void
+bloom_filter_insert(bloom_filter_strategy_t * strategy, const tuple_t * tuples,
+                    uint64_t n);
+
+/**
+ * @brief Allocates the bitmap of an exact filter with one bit per key in
+ * [min, max]. If the range is wider than the m the filter was created with,
+ * the filter is turned into a blocked filter with m, k and B instead.
+ *
+ * @param strategy the exact filter
+ * @param min smallest key, min > max for an empty range
+ * @param max largest key
+ * @return false if the filter fell back to a blocked filter
+ */
+bool
+bloom_filter_exact_init(bloom_filter_strategy_t * strategy, intkey_t min,
+                        intkey_t max);
+
+/**
+ * @brief Builds a static filter from the keys of a relation and inserts them
+ * into its first tier, if it has one. An exact filter is allocated over the
+ * key range of the relation.
+ *
+ * @param strategy the static filter to build
+ * @param tuples the tuples whose keys are inserted
+ * @param n the number of tuples
+ */
+void
+bloom_filter_build(bloom_filter_strategy_t * strategy, const tuple_t * tuples,
+                   uint64_t n);
+
+/**
+ * @brief Copies a built filter, e.g. into a replica that is local to the NUMA
+ * node of the calling thread, which allocates and first touches its memory.
+ *
+ * @param other the filter to be copied
+ * @return the copy of the filter
+ */
+bloom_filter_strategy_t *
+bloom_filter_replicate(const bloom_filter_strategy_t * other);
+
+/**
+ * @brief Clears all entries of the filter so it can be reused for other keys
+ *
+ * @param strategy the filter to be cleared
+ */
+void
+bloom_filter_reset(bloom_filter_strategy_t * strategy);
+
+/**
+ * @brief Clears the bytes [from, to) of the bitmap. Threads can clear disjoint
+ * ranges in parallel, so a filter is reused without a fresh allocation. A
+ * filter created with lazy_clear is left untouched until then, its pages are
+ * placed on the NUMA nodes of the threads clearing them. The same share of the
+ * first tier is cleared along.
+ *
+ * @param strategy the filter to be cleared
+ * @param from first byte of the range
+ * @param to end of the range (exclusive)
+ */
+void
+bloom_filter_reset_range(bloom_filter_strategy_t * strategy, uint64_t from,
+                         uint64_t to);
+
+/**
+ * @brief ORs the bytes [from, to) of the bitmaps of srcs into dst. All filters
+ * must have been created with the same parameters. Threads can merge disjoint
+ * ranges in parallel. The same share of the first tiers is merged along.
+ *
+ * @param dst the filter to merge into
+ * @param srcs the filters to merge
+ * @param nsrcs number of filters in srcs
+ * @param from first byte of the range
+ * @param to end of the range (exclusive)
+ */
+void
+bloom_filter_merge(bloom_filter_strategy_t * dst,
+                   bloom_filter_strategy_t * const * srcs, int nsrcs,
+                   uint64_t from, uint64_t to);
+
+/**
+ * @brief Counts the bits set in the bytes [from, to) of the bitmap. Threads can
+ * count disjoint ranges in parallel, the bits set in all m/8 bytes divided by m
+ * are the fill ratio of the filter.
+ *
+ * @param filter the filter to be counted
+ * @param from first byte of the range
+ * @param to end of the range (exclusive)
+ * @return the number of bits set in the range
+ */
+uint64_t
+bloom_filter_popcount(const bloom_filter_t * filter, uint64_t from,
+                      uint64_t to);
+
+/**
+ * @brief Computes the theoretical FPR of the filter for n inserted keys. A key
+ * has to pass both tiers of a two-tier filter.
+ *
+ * @param strategy the built filter
+ * @param n number of keys inserted into the filter
+ * @return the expected false-positive rate
+ */
+double
+bloom_filter_expected_fpr(const bloom_filter_strategy_t * strategy, uint64_t n);
+
+/**
+ * @brief Prints how well the filter worked. S-tuples that passed the filter
+ * but found no match in the join are false positives, the empirical FPR
+ * relates them to all checked S-tuples without a match and is compared to the
+ * theoretical FPR.
+ *
+ * @param strategy the filter S was checked against
+ * @param nkeys number of keys inserted into the filter
+ * @param checked S-tuples checked against the filter, 0 if unknown
+ * @param passed S-tuples that passed the filter
+ * @param matched S-tuples with at least one match in the join
+ * @param bits bits set in the filter, 0 if not counted. They are printed as
+ * fill ratio, except for a cuckoo filter, which prints the share of occupied
+ * slots, and a xor filter, which prints neither.
+ */
+void
+bloom_filter_print_health(const bloom_filter_strategy_t * strategy,
+                          uint64_t nkeys, uint64_t checked, uint64_t passed,
+                          uint64_t matched, uint64_t bits);
+
+/**
+ * @brief Saves a built filter with its variant, m, k, B and seed to a file,
+ * so later runs can load it instead of inserting R again.
+ *
+ * @param strategy the filter to be saved
+ * @param path the file to write
+ * @return 0 on success, -1 if the file could not be written
+ */
+int
+bloom_filter_save(const bloom_filter_strategy_t * strategy, const char * path);
+
+/**
+ * @brief Maps a filter saved by bloom_filter_save read-only into memory,
+ * backed by huge pages where the kernel supports it. The filter can only be
+ * probed. It is rejected if it was built with other parameters than args, or
+ * for another key size, or if the file is shorter than its filter.
+ *
+ * @param args the parameters the filter must have been built with
+ * @param path the file to map
+ * @return the filter, NULL if the file cannot be loaded
+ */
+bloom_filter_strategy_t *
+bloom_filter_load(bloom_filter_args_t * args, const char * path);
+
 void
 assert_args(bloom_filter_args_t * args);
 
+/**
+ * @brief Chooses the variant, m, k and B that minimize the predicted time of
+ * building the filter from R, checking S against it and partitioning and
+ * probing the tuples of S that pass it. The prediction uses the cache sizes
+ * from sysfs (L2_CACHE_SIZE and LLC_CACHE_SIZE if unknown) and the FPR of a
+ * blocked filter. m does not have to be a power of 2, so the filter can fill
+ * a cache exactly. The chosen parameters are printed.
+ *
+ * @param args [out] the chosen parameters
+ * @param r_size number of tuples in R
+ * @param s_size number of tuples in S
+ * @param selectivity fraction of S-tuples with a match in R
+ * @return false if no filter is predicted to be faster than not filtering
+ */
+bool
+bloom_filter_tune(bloom_filter_args_t * args, uint64_t r_size, uint64_t s_size,
+                  double selectivity);
+
 #endif
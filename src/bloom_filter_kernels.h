@@ -0,0 +1,606 @@
+/**
+ * @file    bloom_filter_kernels.h
+ *
+ * @brief  Inline bloom filter primitives. They are shared by the generic
+ * strategies of bloom_filter.c, which pass k and the block size at runtime,
+ * and by kernels that are specialized for a fixed variant, B and k at compile
+ * time, so the compiler can unroll the hash loop and fold the modulo masks.
+ *
+ */
+#ifndef BLOOM_FILTER_KERNELS_H
+#define BLOOM_FILTER_KERNELS_H
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+#else
+#include "sse2neon.h"
+#endif
+#include <stdatomic.h>
+
+#include "bloom_filter.h"
+#include "hash.h"
+#include "prj_params.h"
+
+#define BLOOM_INLINE static inline __attribute__((always_inline))
+
+/**
+ * @brief Compute mod_m for m which is a power of 2, i.e. m = 2^x
+ *
+ * @param val the value to be taken modulo
+ * @param m the modulo operant, must be a power of 2
+ * @return the resulting value in the range of 0 to m-1
+ */
+BLOOM_INLINE uint32_t
+mod_m(uint32_t val, uint64_t m)
+{
+    return val & (m - 1);
+}
+
+/** salt of the seed of the bits hash, so it is independent of the block hash */
+#define BLOOM_HASH_BITS_SALT 0x85ebca6b
+
+/**
+ * @brief the first hash of enhanced double hashing, i.e. the position of the
+ * first bit of a key, computed by the hash family of the filter. The branch
+ * is the same for all keys of a filter and thus predicted.
+ */
+BLOOM_INLINE uint32_t
+bloom_hash_bits(const bloom_filter_t * filter, const intkey_t key)
+{
+    const uint32_t seed = filter->seed ^ BLOOM_HASH_BITS_SALT;
+
+    switch (filter->hash) {
+        case HASH_CRC:
+            return hash_crc_inline(seed, key);
+        case HASH_MURMUR:
+            return hash_murmur_inline(seed, key);
+        case HASH_MULSHIFT:
+            return hash_mulshift_inline(seed, key);
+        default:
+            return hash_crapwow_inline(filter->seed, key);
+    }
+}
+
+/** the hash that selects the block of a key, see bloom_block_idx */
+BLOOM_INLINE uint32_t
+bloom_hash_block(const bloom_filter_t * filter, const intkey_t key)
+{
+    switch (filter->hash) {
+        case HASH_MURMUR:
+            return hash_murmur_inline(filter->seed, key);
+        case HASH_MULSHIFT:
+            return hash_mulshift_inline(filter->seed, key);
+        default:
+            return hash_crc_inline(filter->seed, key);
+    }
+}
+
+/**
+ * @brief the second hash of enhanced double hashing, the key plus the seed.
+ * The upper half of an 8-byte key is folded in, otherwise keys that only
+ * differ in their upper 32 bits would probe the same sequence of bits.
+ */
+BLOOM_INLINE uint32_t
+bloom_hash2(uint32_t seed, const intkey_t key)
+{
+#ifdef KEY_8B
+    return (uint32_t) key + (uint32_t) ((uint64_t) key >> 32) * 0x9e3779b1
+           + seed;
+#else
+    return key + seed;
+#endif
+}
+
+/**
+ * @brief sets the k bits of a key, positions are computed by enhanced double
+ * hashing
+ *
+ * @param filter the filter, for its seed and hash family
+ * @param key the key to add
+ * @param bitmap the bitmap to set the bits in, separated to support blocked filters
+ * @param size the size of the bitmap, separated to support blocked filters
+ * @param k the number of bits to set
+ */
+BLOOM_INLINE void
+bloom_add_bits(const bloom_filter_t * filter, const intkey_t key,
+               unsigned char * bitmap, uint32_t size, uint64_t k)
+{
+    uint32_t h = bloom_hash_bits(filter, key);
+    uint32_t y = bloom_hash2(filter->seed, key);
+
+    h = mod_m(h, size);
+    y = mod_m(y, size);
+
+    for (int i = 0; i < k; i++) {
+        atomic_fetch_or_explicit(bitmap + (h >> 3), 1 << (h & 7),
+                                 memory_order_relaxed);
+        h = mod_m(h + y, size);
+        y = mod_m(y + i + 1, size);
+    }
+}
+
+/** tests the k bits of a key that are set by bloom_add_bits */
+BLOOM_INLINE bool
+bloom_test_bits(const bloom_filter_t * filter, const intkey_t key,
+                const unsigned char * bitmap, uint32_t size, uint64_t k)
+{
+    uint32_t h = bloom_hash_bits(filter, key);
+    uint32_t y = bloom_hash2(filter->seed, key);
+
+    h = mod_m(h, size);
+    y = mod_m(y, size);
+
+    for (int i = 0; i < k; i++) {
+        if (!(bitmap[h >> 3] & (1 << (h & 7)))) {
+            return false;
+        }
+
+        h = mod_m(h + y, size);
+        y = mod_m(y + i + 1, size);
+    }
+    return true;
+}
+
+/**
+ * @brief the index of the block of a key in a blocked filter. Uses fast range
+ * reduction (multiply-shift) instead of a modulo, so nblocks does not have to
+ * be a power of 2.
+ */
+BLOOM_INLINE uint32_t
+bloom_block_idx(const bloom_filter_t * filter, const intkey_t key,
+                uint64_t nblocks)
+{
+    return ((uint64_t) bloom_hash_block(filter, key) * nblocks) >> 32;
+}
+
+/**
+ * @brief computes the mask of a key for a register-blocked filter, i.e. all k
+ * bits within a single 64-bit word. Uses the same enhanced double hashing as
+ * bloom_add_bits but stays in registers, so the block is only loaded once.
+ *
+ * @param filter the filter, for its seed and hash family
+ * @param key the key to compute the mask for
+ * @param k the number of bits to set
+ * @return the mask with (up to) k bits set
+ */
+BLOOM_INLINE uint64_t
+bloom_register_mask(const bloom_filter_t * filter, const intkey_t key,
+                    uint64_t k)
+{
+    uint32_t h    = bloom_hash_bits(filter, key);
+    uint32_t y    = bloom_hash2(filter->seed, key);
+    uint64_t mask = 0;
+
+    h = mod_m(h, 64);
+    y = mod_m(y, 64);
+
+    for (int i = 0; i < k; i++) {
+        mask |= 1ULL << h;
+        h = mod_m(h + y, 64);
+        y = mod_m(y + i + 1, 64);
+    }
+    return mask;
+}
+
+/** multiplier that spreads the two 32-bit hashes over the sector slices */
+#define BLOOM_SECTOR_MUL 0x9e3779b97f4a7c15ULL
+
+/**
+ * @brief the 64-bit hash of a key in a sectorized filter. The 6-bit slice s
+ * (bits 6s to 6s+5) is the position of the bit in sector s, bits 48 to 50
+ * select the first sector of a round that does not set all sectors.
+ */
+BLOOM_INLINE uint64_t
+bloom_sectorized_hash(const bloom_filter_t * filter, const intkey_t key)
+{
+    return (bloom_hash_bits(filter, key)
+            | (uint64_t) bloom_hash2(filter->seed, key) << 32)
+           * BLOOM_SECTOR_MUL;
+}
+
+/** the hash of the next round of a sectorized filter, for k > 8 */
+BLOOM_INLINE uint64_t
+bloom_sectorized_rehash(uint64_t h)
+{
+    return (h ^ h >> 32) * BLOOM_SECTOR_MUL;
+}
+
+/**
+ * @brief the sectors of a round that sets n bits: all sectors for n >= 8,
+ * otherwise a window of n consecutive sectors (wrapping around), so every
+ * sector gets the same share of the bits.
+ *
+ * @return one bit per sector
+ */
+BLOOM_INLINE uint32_t
+bloom_sectorized_select(uint64_t h, uint64_t n)
+{
+    const uint32_t start = (h >> 48) & (SECTORS_PER_BLOCK - 1);
+    uint32_t       sel;
+
+    if (n >= SECTORS_PER_BLOCK) {
+        return (1U << SECTORS_PER_BLOCK) - 1;
+    }
+    sel = ((1U << n) - 1) << start;
+    return (sel | sel >> SECTORS_PER_BLOCK) & ((1U << SECTORS_PER_BLOCK) - 1);
+}
+
+/**
+ * @brief computes the per-sector masks of a key for a sectorized filter. A
+ * round sets one bit in each selected sector, the positions of all sectors are
+ * taken from the hash at once instead of a loop over the bits. For k > 8 the
+ * hash is remixed for each further round of up to 8 bits.
+ *
+ * @param filter the filter, for its seed and hash family
+ * @param key the key to compute the mask for
+ * @param k the number of bits to set
+ * @param mask [out] one 64-bit mask per sector
+ */
+BLOOM_INLINE void
+bloom_sectorized_mask(const bloom_filter_t * filter, const intkey_t key,
+                      uint64_t k, uint64_t * mask)
+{
+    uint64_t h = bloom_sectorized_hash(filter, key);
+#if defined(__AVX512F__)
+    const __m512i shift = _mm512_setr_epi64(0, 6, 12, 18, 24, 30, 36, 42);
+    const __m512i one   = _mm512_set1_epi64(1);
+    const __m512i m63   = _mm512_set1_epi64(63);
+    __m512i       acc   = _mm512_setzero_si512();
+
+    for (uint64_t i = 0; i < k; i += SECTORS_PER_BLOCK) {
+        __m512i pos = _mm512_and_si512(
+            _mm512_srlv_epi64(_mm512_set1_epi64(h), shift), m63);
+        acc = _mm512_mask_or_epi64(acc, bloom_sectorized_select(h, k - i),
+                                   acc, _mm512_sllv_epi64(one, pos));
+        h   = bloom_sectorized_rehash(h);
+    }
+    _mm512_storeu_si512((void *) mask, acc);
+#elif defined(__AVX2__)
+    const __m256i shift0 = _mm256_setr_epi64x(0, 6, 12, 18);
+    const __m256i shift1 = _mm256_setr_epi64x(24, 30, 36, 42);
+    const __m256i lanes0 = _mm256_setr_epi64x(1, 2, 4, 8);
+    const __m256i lanes1 = _mm256_setr_epi64x(16, 32, 64, 128);
+    const __m256i one    = _mm256_set1_epi64x(1);
+    const __m256i m63    = _mm256_set1_epi64x(63);
+    __m256i       acc0   = _mm256_setzero_si256();
+    __m256i       acc1   = _mm256_setzero_si256();
+
+    for (uint64_t i = 0; i < k; i += SECTORS_PER_BLOCK) {
+        const __m256i hv  = _mm256_set1_epi64x(h);
+        const __m256i sel = _mm256_set1_epi64x(bloom_sectorized_select(h, k - i));
+        __m256i       b0  = _mm256_sllv_epi64(
+            one, _mm256_and_si256(_mm256_srlv_epi64(hv, shift0), m63));
+        __m256i b1 = _mm256_sllv_epi64(
+            one, _mm256_and_si256(_mm256_srlv_epi64(hv, shift1), m63));
+
+        b0   = _mm256_and_si256(
+            b0, _mm256_cmpeq_epi64(_mm256_and_si256(sel, lanes0), lanes0));
+        b1   = _mm256_and_si256(
+            b1, _mm256_cmpeq_epi64(_mm256_and_si256(sel, lanes1), lanes1));
+        acc0 = _mm256_or_si256(acc0, b0);
+        acc1 = _mm256_or_si256(acc1, b1);
+        h    = bloom_sectorized_rehash(h);
+    }
+    _mm256_storeu_si256((__m256i *) mask, acc0);
+    _mm256_storeu_si256((__m256i *) mask + 1, acc1);
+#else
+    for (int s = 0; s < SECTORS_PER_BLOCK; s++) {
+        mask[s] = 0;
+    }
+    for (uint64_t i = 0; i < k; i += SECTORS_PER_BLOCK) {
+        const uint32_t sel = bloom_sectorized_select(h, k - i);
+
+        for (int s = 0; s < SECTORS_PER_BLOCK; s++) {
+            mask[s] |= (uint64_t) (sel >> s & 1) << ((h >> (6 * s)) & 63);
+        }
+        h = bloom_sectorized_rehash(h);
+    }
+#endif
+}
+
+/** sets the sector masks in a sectorized block */
+BLOOM_INLINE void
+bloom_sectorized_add(uint64_t * block, const uint64_t * mask)
+{
+    for (int s = 0; s < SECTORS_PER_BLOCK; s++) {
+        if (mask[s]) {
+            atomic_fetch_or_explicit(block + s, mask[s], memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * @brief tests the bits of a key in its sectorized block, all sectors at once,
+ * i.e. without a branch per bit. With AVX2 or AVX-512, the mask is compared
+ * with the block in vector registers, otherwise the bit of each sector is
+ * shifted out of the block directly, so no mask is stored.
+ */
+BLOOM_INLINE bool
+bloom_sectorized_test(const bloom_filter_t * filter, const intkey_t key,
+                      uint64_t k, const void * block)
+{
+#if defined(__AVX512F__) || defined(__AVX2__)
+    uint64_t mask[SECTORS_PER_BLOCK] __attribute__((aligned(CACHE_LINE_SIZE)));
+
+    bloom_sectorized_mask(filter, key, k, mask);
+#endif
+#if defined(__AVX512F__)
+    __m512i b = _mm512_load_si512((void *) block);
+    __m512i m = _mm512_load_si512((void *) mask);
+    return _mm512_cmpneq_epi64_mask(_mm512_and_si512(b, m), m) == 0;
+#elif defined(__AVX2__)
+    __m256i b0 = _mm256_load_si256((__m256i *) block);
+    __m256i b1 = _mm256_load_si256((__m256i *) block + 1);
+    __m256i m0 = _mm256_load_si256((__m256i *) mask);
+    __m256i m1 = _mm256_load_si256((__m256i *) mask + 1);
+    return _mm256_testc_si256(b0, m0) & _mm256_testc_si256(b1, m1);
+#else
+    const uint64_t * sectors = block;
+    uint64_t         h       = bloom_sectorized_hash(filter, key);
+    uint64_t         miss    = 0;
+
+    for (uint64_t i = 0; i < k; i += SECTORS_PER_BLOCK) {
+        const uint32_t sel = bloom_sectorized_select(h, k - i);
+
+        for (int s = 0; s < SECTORS_PER_BLOCK; s++) {
+            miss |= (sel >> s) & ~(sectors[s] >> ((h >> (6 * s)) & 63)) & 1;
+        }
+        h = bloom_sectorized_rehash(h);
+    }
+    return !miss;
+#endif
+}
+
+#if !defined(KEY_8B) && !defined(__AVX512F__) && defined(__AVX2__)
+/** permutations of the 32-bit lanes that move the selected ones of 4 tuples
+ *  to the front, indexed by the 4 selection bits */
+static const int32_t bloom_compact_lut[16][8] __attribute__((aligned(32))) = {
+    {0, 0, 0, 0, 0, 0, 0, 0}, {0, 1, 0, 0, 0, 0, 0, 0},
+    {2, 3, 0, 0, 0, 0, 0, 0}, {0, 1, 2, 3, 0, 0, 0, 0},
+    {4, 5, 0, 0, 0, 0, 0, 0}, {0, 1, 4, 5, 0, 0, 0, 0},
+    {2, 3, 4, 5, 0, 0, 0, 0}, {0, 1, 2, 3, 4, 5, 0, 0},
+    {6, 7, 0, 0, 0, 0, 0, 0}, {0, 1, 6, 7, 0, 0, 0, 0},
+    {2, 3, 6, 7, 0, 0, 0, 0}, {0, 1, 2, 3, 6, 7, 0, 0},
+    {4, 5, 6, 7, 0, 0, 0, 0}, {0, 1, 4, 5, 6, 7, 0, 0},
+    {2, 3, 4, 5, 6, 7, 0, 0}, {0, 1, 2, 3, 4, 5, 6, 7}};
+#endif
+
+/** tuples that bloom_selection_compact may write beyond the compacted ones */
+#define BLOOM_COMPACT_PADDING 4
+
+/**
+ * @brief copies the selected tuples to a dense buffer. With AVX-512, 8 tuples
+ * are compress-stored at once, with AVX2, 4 tuples are permuted by a lookup
+ * table and stored at once. Otherwise the positions of the set bits are
+ * extracted from the selection words. Tuples that are not selected are not
+ * loaded.
+ *
+ * @param tuples the tuples of the selection
+ * @param n number of tuples
+ * @param sel the selection bitmap of the tuples
+ * @param out [out] the selected tuples, in their order. Needs room for
+ * BLOOM_COMPACT_PADDING tuples more than are selected.
+ * @return the number of selected tuples
+ */
+BLOOM_INLINE uint32_t
+bloom_selection_compact(const tuple_t * tuples, uint32_t n,
+                        const uint64_t * sel, tuple_t * out)
+{
+    uint32_t count = 0;
+
+    for (uint32_t w = 0; w < BLOOM_SEL_WORDS(n); w++) {
+        const tuple_t * t    = tuples + w * 64;
+        uint64_t        bits = sel[w];
+#if !defined(KEY_8B) && defined(__AVX512F__)
+        for (uint32_t i = 0; bits; i += 8, bits >>= 8) {
+            const __mmask8 mask = (__mmask8) bits;
+            if (!mask) continue;
+            __m512i v = _mm512_maskz_loadu_epi64(mask, t + i);
+            _mm512_mask_compressstoreu_epi64(out + count, mask, v);
+            count += __builtin_popcount(mask);
+        }
+#elif !defined(KEY_8B) && defined(__AVX2__)
+        const __m256i lanes = _mm256_setr_epi64x(1, 2, 4, 8);
+        for (uint32_t i = 0; bits; i += 4, bits >>= 4) {
+            const uint32_t mask = bits & 0xf;
+            if (!mask) continue;
+            __m256i m = _mm256_cmpeq_epi64(
+                _mm256_and_si256(_mm256_set1_epi64x(mask), lanes), lanes);
+            __m256i v = _mm256_maskload_epi64((const long long *) (t + i), m);
+            v         = _mm256_permutevar8x32_epi32(
+                v, _mm256_load_si256((const __m256i *) bloom_compact_lut[mask]));
+            _mm256_storeu_si256((__m256i *) (out + count), v);
+            count += __builtin_popcount(mask);
+        }
+#else
+        while (bits) {
+            out[count++] = t[__builtin_ctzll(bits)];
+            bits &= bits - 1;
+        }
+#endif
+    }
+    return count;
+}
+
+// clang-format off
+/** tests the keys of a prefetched group and deselects the negatives */
+#define BLOOM_TEST_GROUP(TEST, G)                                       \
+    for (uint32_t j = 0; j < G; j++) {                                  \
+        if (TEST(filter, key[j], addr[j]))                              \
+            count++;                                                    \
+        else                                                            \
+            sel[idx[j] >> 6] &= ~(1ULL << (idx[j] & 63));               \
+    }
+
+/**
+ * Body of the batched contains of a variant, see
+ * bloom_filter_contains_batch_strategy_t for the parameters filter, tuples, n
+ * and sel. LOCATE(filter, key) returns the address of the word or block of a
+ * key that is prefetched and TEST(filter, key, addr) checks the key given that
+ * address.
+ */
+#define BLOOM_CONTAINS_BATCH_BODY(LOCATE, TEST)                         \
+    uint32_t     idx[BLOOM_PREFETCH_GROUP];                             \
+    intkey_t     key[BLOOM_PREFETCH_GROUP];                             \
+    const void * addr[BLOOM_PREFETCH_GROUP];                            \
+    uint64_t     count = 0;                                             \
+    uint32_t     g     = 0;                                             \
+                                                                        \
+    for (uint32_t w = 0; w < BLOOM_SEL_WORDS(n); w++) {                 \
+        uint64_t bits = sel[w];                                         \
+        while (bits) {                                                  \
+            idx[g]  = w * 64 + __builtin_ctzll(bits);                   \
+            key[g]  = tuples[idx[g]].key;                               \
+            addr[g] = LOCATE(filter, key[g]);                           \
+            __builtin_prefetch(addr[g], 0, 3);                          \
+            bits &= bits - 1;                                           \
+            if (++g == BLOOM_PREFETCH_GROUP) {                          \
+                BLOOM_TEST_GROUP(TEST, BLOOM_PREFETCH_GROUP)            \
+                g = 0;                                                  \
+            }                                                           \
+        }                                                               \
+    }                                                                   \
+    BLOOM_TEST_GROUP(TEST, g)                                           \
+    return count;
+
+/*
+ * Specializations of the variants for a fixed block size B and k, each
+ * defines bloom_add_<V>_<B>_<K>(filter, key),
+ * bloom_locate_<V>_<B>_<K>(filter, key) and
+ * bloom_test_<V>_<B>_<K>(filter, key, addr). B is ignored for BASIC and fixed
+ * by the variant for REGISTER_BLOCKED and SECTORIZED.
+ */
+#define BLOOM_SPECIALIZE_BASIC(B, K)                                    \
+    BLOOM_INLINE void                                                   \
+    bloom_add_BASIC_##B##_##K(const bloom_filter_t * filter,            \
+                              const intkey_t key)                       \
+    {                                                                   \
+        bloom_add_bits(filter, key, filter->bitmap, filter->m, K);     \
+    }                                                                   \
+    BLOOM_INLINE const void *                                           \
+    bloom_locate_BASIC_##B##_##K(const bloom_filter_t * filter,         \
+                                 const intkey_t key)                    \
+    {                                                                   \
+        uint32_t h = mod_m(bloom_hash_bits(filter, key), filter->m);    \
+        return filter->bitmap + (h >> 3);                               \
+    }                                                                   \
+    BLOOM_INLINE bool                                                   \
+    bloom_test_BASIC_##B##_##K(const bloom_filter_t * filter,           \
+                               const intkey_t key, const void * addr)   \
+    {                                                                   \
+        return bloom_test_bits(filter, key, filter->bitmap, filter->m,  \
+                               K);                                      \
+    }
+
+#define BLOOM_SPECIALIZE_BLOCKED(B, K)                                  \
+    BLOOM_INLINE const void *                                           \
+    bloom_locate_BLOCKED_##B##_##K(const bloom_filter_t * filter,       \
+                                   const intkey_t key)                  \
+    {                                                                   \
+        return filter->bitmap                                           \
+               + bloom_block_idx(filter, key, filter->nblocks)          \
+                     * (B / 8);                                         \
+    }                                                                   \
+    BLOOM_INLINE void                                                   \
+    bloom_add_BLOCKED_##B##_##K(const bloom_filter_t * filter,          \
+                                const intkey_t key)                     \
+    {                                                                   \
+        bloom_add_bits(filter, key,                                     \
+                       (unsigned char *) bloom_locate_BLOCKED_##B##_##K(\
+                           filter, key), B, K);                         \
+    }                                                                   \
+    BLOOM_INLINE bool                                                   \
+    bloom_test_BLOCKED_##B##_##K(const bloom_filter_t * filter,         \
+                                 const intkey_t key, const void * addr) \
+    {                                                                   \
+        return bloom_test_bits(filter, key, addr, B, K);                \
+    }
+
+#define BLOOM_SPECIALIZE_REGISTER_BLOCKED(B, K)                         \
+    BLOOM_INLINE const void *                                           \
+    bloom_locate_REGISTER_BLOCKED_##B##_##K(const bloom_filter_t * filter,\
+                                            const intkey_t key)         \
+    {                                                                   \
+        return (uint64_t *) filter->bitmap                              \
+               + bloom_block_idx(filter, key, filter->nblocks);         \
+    }                                                                   \
+    BLOOM_INLINE void                                                   \
+    bloom_add_REGISTER_BLOCKED_##B##_##K(const bloom_filter_t * filter, \
+                                         const intkey_t key)            \
+    {                                                                   \
+        atomic_fetch_or_explicit(                                       \
+            (uint64_t *) bloom_locate_REGISTER_BLOCKED_##B##_##K(filter,\
+                                                                 key),  \
+            bloom_register_mask(filter, key, K),                        \
+            memory_order_relaxed);                                      \
+    }                                                                   \
+    BLOOM_INLINE bool                                                   \
+    bloom_test_REGISTER_BLOCKED_##B##_##K(const bloom_filter_t * filter,\
+                                          const intkey_t key,           \
+                                          const void * addr)            \
+    {                                                                   \
+        uint64_t mask = bloom_register_mask(filter, key, K);            \
+        return (*(const uint64_t *) addr & mask) == mask;               \
+    }
+
+#define BLOOM_SPECIALIZE_SECTORIZED(B, K)                               \
+    BLOOM_INLINE const void *                                           \
+    bloom_locate_SECTORIZED_##B##_##K(const bloom_filter_t * filter,    \
+                                      const intkey_t key)               \
+    {                                                                   \
+        return (uint64_t *) filter->bitmap                              \
+               + bloom_block_idx(filter, key, filter->nblocks)          \
+                     * SECTORS_PER_BLOCK;                               \
+    }                                                                   \
+    BLOOM_INLINE void                                                   \
+    bloom_add_SECTORIZED_##B##_##K(const bloom_filter_t * filter,       \
+                                   const intkey_t key)                  \
+    {                                                                   \
+        uint64_t mask[SECTORS_PER_BLOCK];                               \
+        bloom_sectorized_mask(filter, key, K, mask);                    \
+        bloom_sectorized_add(                                           \
+            (uint64_t *) bloom_locate_SECTORIZED_##B##_##K(filter, key),\
+            mask);                                                      \
+    }                                                                   \
+    BLOOM_INLINE bool                                                   \
+    bloom_test_SECTORIZED_##B##_##K(const bloom_filter_t * filter,      \
+                                    const intkey_t key,                 \
+                                    const void * addr)                  \
+    {                                                                   \
+        return bloom_sectorized_test(filter, key, K, addr);             \
+    }
+
+/**
+ * Instantiates the specialization of VARIANT for B and K and its batched
+ * contains bloom_contains_batch_<V>_<B>_<K>(filter, tuples, n, sel).
+ */
+#define BLOOM_SPECIALIZE(VARIANT, B, K)                                 \
+    BLOOM_SPECIALIZE_##VARIANT(B, K)                                    \
+    BLOOM_INLINE uint64_t                                               \
+    bloom_contains_batch_##VARIANT##_##B##_##K(                         \
+        const bloom_filter_t * filter, const tuple_t * tuples,          \
+        uint32_t n, uint64_t * sel)                                     \
+    {                                                                   \
+        BLOOM_CONTAINS_BATCH_BODY(bloom_locate_##VARIANT##_##B##_##K,   \
+                                  bloom_test_##VARIANT##_##B##_##K)     \
+    }
+
+#define BLOOM_KERNELS_K(X, VARIANT, B)                                  \
+    X(VARIANT, B, 1) X(VARIANT, B, 2) X(VARIANT, B, 3) X(VARIANT, B, 4) \
+    X(VARIANT, B, 5) X(VARIANT, B, 6) X(VARIANT, B, 7) X(VARIANT, B, 8)
+
+/**
+ * X-macro table of the (variant, B, k) combinations that get a specialized
+ * kernel. X(VARIANT, B, K) is expanded for each of them, filters with other
+ * parameters use the generic strategy. B is 0 for BASIC since it is unused.
+ */
+#define BLOOM_KERNELS(X)                                                \
+    BLOOM_KERNELS_K(X, BASIC, 0)                                        \
+    BLOOM_KERNELS_K(X, BLOCKED, 256)                                    \
+    BLOOM_KERNELS_K(X, BLOCKED, 512)                                    \
+    BLOOM_KERNELS_K(X, BLOCKED, 1024)                                   \
+    BLOOM_KERNELS_K(X, REGISTER_BLOCKED, 64)                            \
+    BLOOM_KERNELS_K(X, SECTORIZED, 512)
+// clang-format on
+
+#endif /* BLOOM_FILTER_KERNELS_H */
@@ -243,3 +243,37 @@ get_numa_node_of_address(void * ptr)
     get_mempolicy(&numa_node, NULL, 0, ptr, MPOL_F_NODE | MPOL_F_ADDR);
     return numa_node;
 }
+
+long
+get_cache_size(int level)
+{
+    char   path[128], type[32], unit = 0;
+    int    lvl;
+    long   size;
+    FILE * f;
+
+    for (int idx = 0;; idx++) {
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/cpu/cpu0/cache/index%d/level", idx);
+        if ((f = fopen(path, "r")) == NULL) break;
+        if (fscanf(f, "%d", &lvl) != 1) lvl = -1;
+        fclose(f);
+        if (lvl != level) continue;
+
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/cpu/cpu0/cache/index%d/type", idx);
+        if ((f = fopen(path, "r")) == NULL) continue;
+        if (fscanf(f, "%31s", type) != 1) type[0] = 0;
+        fclose(f);
+        if (type[0] == 'I') continue; /* Instruction cache */
+
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/cpu/cpu0/cache/index%d/size", idx);
+        if ((f = fopen(path, "r")) == NULL) continue;
+        if (fscanf(f, "%ld%c", &size, &unit) < 1) size = 0;
+        fclose(f);
+
+        return unit == 'K' ? size << 10 : unit == 'M' ? size << 20 : size;
+    }
+    return 0;
+}
@@ -53,6 +53,17 @@ get_num_numa_regions(void);
 int 
 get_numa_node_of_address(void * ptr);
 
+/**
+ * Returns the size in bytes of the data or unified cache of the given level
+ * (1, 2, 3) of CPU-0 as reported by sysfs.
+ *
+ * @param level the cache level
+ *
+ * @return the cache size or 0 if it is unknown
+ */
+long
+get_cache_size(int level);
+
 /** @} */
 
 #endif /* CPU_MAPPING_H */
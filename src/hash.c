@@ -6,7 +6,7 @@
 uint32_t
 hash_crc(uint32_t seed, intkey_t key)
 {
-    return _mm_crc32_u32(seed, key);
+    return hash_crc_inline(seed, key);
 }
 
 uint32_t
@@ -23,27 +23,10 @@ hash_FNV(uint32_t seed, intkey_t key)
     return h;
 }
 
-// Source https://web.archive.org/web/20150531125306/http://floodyberry.com/noncryptohashzoo/CrapWow.html
-#define cwfold(a, b, lo, hi)         \
-{                                    \
-p = (uint32_t) (a) * (uint64_t) (b); \
-lo ^= (uint32_t) p;                  \
-hi ^= (uint32_t) (p >> 32);          \
-}
-#define cwmixb(in) cwfold(in, n, h, k)
-
 uint32_t
 hash_crapwow(uint32_t seed, intkey_t key)
 {
-    // Source https://web.archive.org/web/20150531125306/http://floodyberry.com/noncryptohashzoo/CrapWow.html
-    uint32_t n = 0x5052acdb;
-    uint32_t h = sizeof(intkey_t);
-    uint32_t k = h + seed + n;
-    uint64_t p;
-
-    cwmixb(key);
-    cwmixb(h ^ (k + n));
-    return k ^ h;
+    return hash_crapwow_inline(seed, key);
 }
 
 static inline uint32_t
@@ -138,4 +121,55 @@ hash_x17(uint32_t seed, intkey_t key)
         h         = 17 * h + (byte - ' ');
     }
     return h ^ (h >> 16);
-}
\ No newline at end of file
+}
+uint32_t
+hash_murmur(uint32_t seed, intkey_t key)
+{
+    return hash_murmur_inline(seed, key);
+}
+
+uint32_t
+hash_mulshift(uint32_t seed, intkey_t key)
+{
+    return hash_mulshift_inline(seed, key);
+}
+
+void
+hash_mulshift_batch(uint32_t seed, const tuple_t * tuples, uint32_t n,
+                    uint32_t * out)
+{
+    uint32_t i = 0;
+
+#ifndef KEY_8B
+    /* a tuple is a 64-bit lane with the key in its lower half, which is the
+     * operand of mul_epu32. The upper 32 bits of x * A are
+     * (x * A_lo >> 32) + x * A_hi, modulo 2^32. */
+#if defined(__AVX512F__)
+    const __m512i s    = _mm512_set1_epi64(seed);
+    const __m512i a_lo = _mm512_set1_epi64(HASH_MULSHIFT_A & 0xffffffff);
+    const __m512i a_hi = _mm512_set1_epi64(HASH_MULSHIFT_A >> 32);
+    for (; i + 8 <= n; i += 8) {
+        __m512i x  = _mm512_xor_si512(_mm512_loadu_si512(tuples + i), s);
+        __m512i lo = _mm512_srli_epi64(_mm512_mul_epu32(x, a_lo), 32);
+        __m512i h  = _mm512_add_epi64(lo, _mm512_mul_epu32(x, a_hi));
+        _mm256_storeu_si256((__m256i *) (out + i), _mm512_cvtepi64_epi32(h));
+    }
+#elif defined(__AVX2__)
+    const __m256i s    = _mm256_set1_epi64x(seed);
+    const __m256i a_lo = _mm256_set1_epi64x(HASH_MULSHIFT_A & 0xffffffff);
+    const __m256i a_hi = _mm256_set1_epi64x(HASH_MULSHIFT_A >> 32);
+    const __m256i even = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+    for (; i + 4 <= n; i += 4) {
+        __m256i x  = _mm256_xor_si256(
+            _mm256_loadu_si256((const __m256i *) (tuples + i)), s);
+        __m256i lo = _mm256_srli_epi64(_mm256_mul_epu32(x, a_lo), 32);
+        __m256i h  = _mm256_add_epi64(lo, _mm256_mul_epu32(x, a_hi));
+        h          = _mm256_permutevar8x32_epi32(h, even);
+        _mm_storeu_si128((__m128i *) (out + i), _mm256_castsi256_si128(h));
+    }
+#endif
+#endif
+    for (; i < n; i++) {
+        out[i] = hash_mulshift_inline(seed, tuples[i].key);
+    }
+}
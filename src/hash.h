@@ -1,3 +1,6 @@
+#ifndef HASH_H
+#define HASH_H
+
 #if defined(__i386__) || defined(__x86_64__)
 #include <immintrin.h>
 #else
@@ -9,6 +12,80 @@
 
 typedef uint32_t (*hash_fn_t)(uint32_t seed, intkey_t key);
 
+/** inlineable version of hash_crc for hot loops, e.g. the filter kernels */
+static inline uint32_t
+hash_crc_inline(uint32_t seed, intkey_t key)
+{
+#ifdef KEY_8B
+    return (uint32_t) _mm_crc32_u64(seed, key);
+#else
+    return _mm_crc32_u32(seed, key);
+#endif
+}
+
+/** inlineable version of hash_crapwow for hot loops, e.g. the filter kernels */
+static inline uint32_t
+hash_crapwow_inline(uint32_t seed, intkey_t key)
+{
+    // Source https://web.archive.org/web/20150531125306/http://floodyberry.com/noncryptohashzoo/CrapWow.html
+    uint32_t n = 0x5052acdb;
+    uint32_t h = sizeof(intkey_t);
+    uint32_t k = h + seed + n;
+    uint64_t p;
+
+    p = (uint32_t) key * (uint64_t) n;
+    h ^= (uint32_t) p;
+    k ^= (uint32_t) (p >> 32);
+#ifdef KEY_8B
+    /* the upper half of an 8-byte key is mixed in with the second multiplier */
+    uint32_t m = 0x57559429;
+    p          = (uint32_t) ((uint64_t) key >> 32) * (uint64_t) m;
+    k ^= (uint32_t) p;
+    h ^= (uint32_t) (p >> 32);
+#endif
+    p = (uint32_t) (h ^ (k + n)) * (uint64_t) n;
+    h ^= (uint32_t) p;
+    k ^= (uint32_t) (p >> 32);
+    return k ^ h;
+}
+
+/**
+ * inlineable 32-bit murmur3 finalizer (fmix64) of the key and the seed, mixes
+ * all bits of 8-byte keys
+ */
+static inline uint32_t
+hash_murmur_inline(uint32_t seed, intkey_t key)
+{
+    // Source: https://github.com/aappleby/smhasher/blob/master/src/MurmurHash3.cpp
+    uint64_t h = (uint64_t) key ^ ((uint64_t) seed << 32 | seed);
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return (uint32_t) h;
+}
+
+/** odd 64-bit multiplier of hash_mulshift, 2^64 divided by the golden ratio */
+#define HASH_MULSHIFT_A 0x9e3779b97f4a7c15ULL
+
+/**
+ * inlineable multiply-shift hash (Dietzfelbinger et al.): the upper 32 bits of
+ * the 64-bit product of the key and an odd constant. A single multiplication,
+ * so it is also cheap to vectorize, see hash_mulshift_batch.
+ */
+static inline uint32_t
+hash_mulshift_inline(uint32_t seed, intkey_t key)
+{
+#ifdef KEY_8B
+    uint64_t x = (uint64_t) key ^ seed;
+#else
+    uint64_t x = (uint32_t) key ^ seed;
+#endif
+    return x * HASH_MULSHIFT_A >> 32;
+}
+
 uint32_t
 hash_crc(uint32_t seed, intkey_t key);
 
@@ -38,3 +115,25 @@ hash_DJB2(uint32_t seed, intkey_t key);
 
 uint32_t
 hash_x17(uint32_t seed, intkey_t key);
+
+uint32_t
+hash_murmur(uint32_t seed, intkey_t key);
+
+uint32_t
+hash_mulshift(uint32_t seed, intkey_t key);
+
+/**
+ * @brief hash_mulshift of the keys of n tuples. With AVX2 (AVX-512) the keys
+ * of 4 (8) tuples are hashed by one multiplication per half of the constant,
+ * the scalar hash is used for 8-byte keys and for the remainder.
+ *
+ * @param seed the seed of the hash
+ * @param tuples the tuples whose keys are hashed
+ * @param n the number of tuples
+ * @param out [out] the n hashes, out[i] = hash_mulshift(seed, tuples[i].key)
+ */
+void
+hash_mulshift_batch(uint32_t seed, const tuple_t * tuples, uint32_t n,
+                    uint32_t * out);
+
+#endif
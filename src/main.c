@@ -19,6 +19,7 @@
  *
  *  - NPO:    No Partitioning Join Optimized (Hardware-oblivious algo. in paper)
  *  - PRO:    Parallel Radix Join Optimized (Hardware-conscious algo. in paper)
+ *  - PROT:   Parallel Radix Join Optimized with fingerprint-tagged buckets
  *  - PRH:    Parallel Radix Join Histogram-based
  *  - PRHO:   Parallel Radix Join Histogram-based Optimized
  *  - RJ:     Radix Join (single-threaded)
@@ -83,7 +84,7 @@
  * The <tt>mchashjoins</tt> binary understands the following command line
  * options:
  * @verbatim
-      Join algorithm selection, algorithms : RJ, PRO, PRH, PRHO, NPO, NPO_st
+      Join algorithm selection, algorithms : RJ, PRO, PROT, PRH, PRHO, NPO, NPO_st
          -a --algo=<name>    Run the hash join algorithm named <name> [PRO]
 
       Other join configuration options, with default values in [] :
@@ -99,10 +100,46 @@
          --basic-numa         Numa-localize relations to threads (Experimental)
 
       Bloom Filter options:
-         -b --bloom-filter=<b>           bloom filter type: no, basic, blocked
+         -b --bloom-filter=<b>           bloom filter type: no, basic, blocked, register,
+                                         sectorized, cuckoo (16-bit fingerprints, ignores k),
+                                         xor (static, built from R, ignores m and k),
+                                         exact (one bit per key in R's key range, a
+                                         blocked filter if the range is wider than m),
+                                         auto (chooses variant, m, k and B from |R|, |S|,
+                                         -q and the cache sizes)
          -k --bloom-hashes=<k>           number of bits set per tuple (computed hashes)
-         -m --bloom-size=<m>             number of filter entries in bits
+         -m --bloom-size=<m>             number of filter entries in bits (power of 2 for
+                                         basic and cuckoo, multiple of the block size otherwise)
          -B --bloom-block-size=<B>       number of bits per block for blocked bloom filter (B = 2^x)
+                                         (register always uses one 64-bit word per key,
+                                         sectorized one 512-bit cache line)
+         --bloom-local-build             Build thread-local filters that are merged
+                                         after pass-1 of R (needs m/8 bytes per thread)
+         -P --bloom-placement=<p>        where S is filtered: global (one filter in pass-1)
+                                         or local (one L2-sized filter per pass-1
+                                         partition, checked in pass-2) [global]
+         -T --bloom-bypass=<t>           stop checking S against a global filter in a
+                                         thread if more than t of its first tuples
+                                         pass, 1 never bypasses [1]
+         --bloom-replicate               Copy the global filter to each NUMA node once
+                                         it is built, S is probed against the local copy
+         -W --bloom-save=<file>          Save the global filter built from R to a file
+         -L --bloom-load=<file>          Map a filter saved with the same -b, -m, -k, -B
+                                         and -H instead of inserting R
+         --bloom-semi-join               Insert the S-tuples passing pass-1 into a second
+                                         filter and drop the R-tuples failing it in pass-2
+         --bloom-prune                   Drop the S-tuples outside the key range of their
+                                         pass-1 partition of R before the global filter
+         --bloom-adaptive-pass2          Choose the pass-2 radix bits per pass-1 partition
+                                         so that its hash tables fit a share of L2,
+                                         instead of the fixed PASS2RADIXBITS
+         -F --bloom-prefilter-size=<m>   Check S first against a cache-resident register
+                                         blocked filter of m bits (multiple of 64), 0 for
+                                         a single tier [0]
+         -K --bloom-prefilter-hashes=<k> number of bits per key in the first tier [2]
+         -H --bloom-hash=<h>             hash family of the filters: crapwow (bits) and
+                                         crc (blocks), crc, murmur (fmix64) or mulshift
+                                         (multiply-shift) [crapwow]
 
       Performance profiling options, when compiled with --enable-perfcounters.
          -p --perfconf=<P>  Intel PCM config file with upto 4 counters [none]
@@ -256,7 +293,7 @@ cpu-mapping.txt
 #include "bloom_filter.h" /* bloom_filter_x */
 #include "generator.h"    /* create_relation_xk */
 #include "no_partitioning_join.h" /* no partitioning joins: NPO, NPO_st */
-#include "parallel_radix_join.h"  /* parallel radix joins: RJ, PRO, PRH, PRHO */
+#include "parallel_radix_join.h"  /* parallel radix joins: RJ, PRO, PROT, PRH, PRHO */
 #include "parallel_radix_join_bloom.h" /* parallel radix joins: RBJ, PRBO, PRBH, PRBHO */
 #include "perf_counters.h"             /* PCM_x */
 
@@ -301,6 +338,7 @@ struct param_t {
     char * loadfileS;
     /** bloom filter args*/
     bool                bloom_enable;
+    bool                bloom_auto; /* choose the filter parameters */
     bloom_filter_args_t bloom_filter_args;
 };
 
@@ -311,30 +349,15 @@ extern int    optind, opterr, optopt;
 extern int numalocalize; /* defined in generator.c */
 extern int nthreads;     /* defined in generator.c */
 
-/** wrapper for NPO, not using bloom filter because there is no partitioning */
-result_t *
-B_NPO(relation_t * relR, relation_t * relS, int nthreads,
-      bloom_filter_args_t * bloom_args)
-{
-    return NPO(relR, relS, nthreads);
-}
-
-/** wrapper for NPO_st, not using bloom filter because there is no partitioning */
-result_t *
-B_NPO_st(relation_t * relR, relation_t * relS, int nthreads,
-         bloom_filter_args_t * bloom_args)
-{
-    return NPO_st(relR, relS, nthreads);
-}
-
 /** all available algorithms */
 static struct algo_t algos[] = {
     {"PRO",    PRO,    BPRO    },
+    {"PROT",   PROT,   BPROT   },
     {"RJ",     RJ,     BRJ     },
     {"PRH",    PRH,    BPRH    },
     {"PRHO",   PRHO,   BPRHO   },
-    {"NPO",    NPO,    B_NPO   },
-    {"NPO_st", NPO_st, B_NPO_st}, /* NPO single threaded */
+    {"NPO",    NPO,    BNPO    },
+    {"NPO_st", NPO_st, BNPO_st }, /* NPO single threaded */
     {{0},      0,      0       }
 };
 
@@ -386,14 +409,34 @@ main(int argc, char ** argv)
     cmd_params.loadfileS      = NULL;
 
     /* default bloom params*/
-    cmd_params.bloom_enable              = false;
-    cmd_params.bloom_filter_args.variant = BASIC;
-    cmd_params.bloom_filter_args.m       = 256 << 20;  // 256 Mb
-    cmd_params.bloom_filter_args.k       = 8;
-    cmd_params.bloom_filter_args.B       = 1024;
+    cmd_params.bloom_enable                  = false;
+    cmd_params.bloom_auto                    = false;
+    cmd_params.bloom_filter_args.variant     = BASIC;
+    cmd_params.bloom_filter_args.m           = 256 << 20;  // 256 Mb
+    cmd_params.bloom_filter_args.k           = 8;
+    cmd_params.bloom_filter_args.B           = 1024;
+    cmd_params.bloom_filter_args.local_build = false;
+    cmd_params.bloom_filter_args.placement   = PASS1_GLOBAL;
+    cmd_params.bloom_filter_args.bypass_threshold = 1.0;
+    cmd_params.bloom_filter_args.replicate        = false;
+    cmd_params.bloom_filter_args.save_path        = NULL;
+    cmd_params.bloom_filter_args.load_path        = NULL;
+    cmd_params.bloom_filter_args.semi_join        = false;
+    cmd_params.bloom_filter_args.prefilter_m      = 0;
+    cmd_params.bloom_filter_args.prefilter_k      = 2;
+    cmd_params.bloom_filter_args.lazy_clear       = false;
+    cmd_params.bloom_filter_args.hash             = HASH_CRAPWOW;
+    cmd_params.bloom_filter_args.prune            = false;
+    cmd_params.bloom_filter_args.adaptive_pass2   = false;
 
     parse_args(argc, argv, &cmd_params);
 
+    if (cmd_params.bloom_auto) {
+        cmd_params.bloom_enable = bloom_filter_tune(
+            &cmd_params.bloom_filter_args, cmd_params.r_size,
+            cmd_params.s_size, cmd_params.selectivity);
+    }
+
 #ifdef PERF_COUNTERS
     // PCM_CONFIG = cmd_params.perfconf;
     // PCM_OUT    = cmd_params.perfout;
@@ -502,7 +545,7 @@ print_help(char * progname)
     printf("Usage: %s [options]\n", progname);
 
     printf("\
-    Join algorithm selection, algorithms : RJ, PRO, PRH, PRHO, NPO, NPO_st     \n\
+    Join algorithm selection, algorithms : RJ, PRO, PROT, PRH, PRHO, NPO, NPO_st\n\
        -a --algo=<name>    Run the hash join algorithm named <name> [PRO]      \n\
                                                                                \n\
     Other join configuration options, with default values in [] :              \n\
@@ -518,12 +561,40 @@ print_help(char * progname)
        --non-unique       Use non-unique (duplicated) keys in input relations  \n\
        --full-range       Spread keys in relns. in full 32-bit integer range   \n\
        --basic-numa       Numa-localize relations to threads (Experimental)    \n\
-                                                                               \n\
+                                                                               \n");
+
+    /* split, the whole help exceeds the string length compilers support */
+    printf("\
     Bloom Filter options:                                                      \n\
-       -b --bloom-filter=<b>           bloom filter type: no, basic, blocked   \n\
+       -b --bloom-filter=<b>           bloom filter type: no, basic, blocked,  \n\
+                                       register, sectorized, cuckoo, xor,      \n\
+                                       exact, auto                             \n\
        -k --bloom-hashes=<k>           number of bits set per tuple (computed hashes) \n\
        -m --bloom-size=<m>             number of filter entries in bits               \n\
        -B --bloom-block-size=<B>       number of bits per block (B = 2^x) (blocked)   \n\
+       --bloom-local-build             build thread-local filters and merge them      \n\
+                                       (needs m/8 bytes per thread)                   \n\
+       -P --bloom-placement=<p>        global: check S in pass-1 against one filter   \n\
+                                       local: check S in pass-2 against L2-sized      \n\
+                                       filters of the R partitions [global]           \n\
+       -T --bloom-bypass=<t>           bypass a global filter per thread if a sample  \n\
+                                       of S passes with a rate above t [1]            \n\
+       --bloom-replicate               probe S against a copy of the global filter    \n\
+                                       on the NUMA node of each thread                \n\
+       -W --bloom-save=<file>          save the global filter built from R            \n\
+       -L --bloom-load=<file>          map a saved filter instead of inserting R,     \n\
+                                       it must have the same -b, -m, -k, -B and -H    \n\
+       --bloom-semi-join               also drop R-tuples in pass-2 that fail a       \n\
+                                       filter built from S in pass-1                  \n\
+       --bloom-prune                   drop S-tuples outside the key range of their   \n\
+                                       pass-1 partition of R before the global filter \n\
+       --bloom-adaptive-pass2          pass-2 radix bits per pass-1 partition by its  \n\
+                                       size instead of the fixed PASS2RADIXBITS       \n\
+       -F --bloom-prefilter-size=<m>   bits of a cache-resident first tier that S is  \n\
+                                       checked against before the filter [0: none]    \n\
+       -K --bloom-prefilter-hashes=<k> bits per key in the first tier [2]             \n\
+       -H --bloom-hash=<h>             hash family: crapwow, crc, murmur, mulshift    \n\
+                                       [crapwow]                                      \n\
                                                                                \n\
     Performance profiling options, when compiled with --enable-perfcounters.   \n\
        -p --perfconf=<P>  Intel PCM config file with upto 4 counters [none]    \n\
@@ -564,6 +635,11 @@ parse_args(int argc, char ** argv, param_t * cmd_params)
     static int nonunique_flag;
     static int fullrange_flag;
     static int basic_numa;
+    static int bloom_local_build;
+    static int bloom_replicate;
+    static int bloom_semi_join;
+    static int bloom_prune;
+    static int bloom_adaptive_pass2;
 
     while (1) {
         static struct option long_options[] = {
@@ -573,6 +649,11 @@ parse_args(int argc, char ** argv, param_t * cmd_params)
             {"non-unique",       no_argument,       &nonunique_flag, 1  },
             {"full-range",       no_argument,       &fullrange_flag, 1  },
             {"basic-numa",       no_argument,       &basic_numa,     1  },
+            {"bloom-local-build", no_argument,      &bloom_local_build, 1 },
+            {"bloom-replicate",  no_argument,       &bloom_replicate, 1 },
+            {"bloom-semi-join",  no_argument,       &bloom_semi_join, 1 },
+            {"bloom-prune",      no_argument,       &bloom_prune,    1  },
+            {"bloom-adaptive-pass2", no_argument,   &bloom_adaptive_pass2, 1 },
             {"help",             no_argument,       0,               'h'},
             {"version",          no_argument,       0,               'v'},
  /* These options don't set a flag.
@@ -593,12 +674,19 @@ parse_args(int argc, char ** argv, param_t * cmd_params)
             {"bloom-size",       required_argument, 0,               'm'},
             {"bloom-hashes",     required_argument, 0,               'k'},
             {"bloom-block-size", required_argument, 0,               'B'},
+            {"bloom-placement",  required_argument, 0,               'P'},
+            {"bloom-bypass",     required_argument, 0,               'T'},
+            {"bloom-save",       required_argument, 0,               'W'},
+            {"bloom-load",       required_argument, 0,               'L'},
+            {"bloom-prefilter-size", required_argument, 0,           'F'},
+            {"bloom-prefilter-hashes", required_argument, 0,         'K'},
+            {"bloom-hash",       required_argument, 0,               'H'},
             {0,                  0,                 0,               0  }
         };
         /* getopt_long stores the option index here. */
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "a:n:p:q:r:s:o:x:y:z:R:S:b:m:k:B:Z:A:hv",
+        c = getopt_long(argc, argv, "a:n:p:q:r:s:o:x:y:z:R:S:b:m:k:B:P:T:W:L:F:K:H:Z:A:hv",
                         long_options, &option_index);
 
         /* Detect the end of the options. */
@@ -691,10 +779,21 @@ parse_args(int argc, char ** argv, param_t * cmd_params)
 
             case 'b':
                 cmd_params->bloom_enable = strcmp(optarg, "no") != 0;
+                cmd_params->bloom_auto   = strcmp(optarg, "auto") == 0;
                 if (strcmp(optarg, "basic") == 0)
                     cmd_params->bloom_filter_args.variant = BASIC;
                 else if (strcmp(optarg, "blocked") == 0)
                     cmd_params->bloom_filter_args.variant = BLOCKED;
+                else if (strcmp(optarg, "register") == 0)
+                    cmd_params->bloom_filter_args.variant = REGISTER_BLOCKED;
+                else if (strcmp(optarg, "sectorized") == 0)
+                    cmd_params->bloom_filter_args.variant = SECTORIZED;
+                else if (strcmp(optarg, "cuckoo") == 0)
+                    cmd_params->bloom_filter_args.variant = CUCKOO;
+                else if (strcmp(optarg, "xor") == 0)
+                    cmd_params->bloom_filter_args.variant = XOR;
+                else if (strcmp(optarg, "exact") == 0)
+                    cmd_params->bloom_filter_args.variant = EXACT;
                 break;
             case 'm':
                 cmd_params->bloom_filter_args.m = atoll(optarg);
@@ -706,6 +805,49 @@ parse_args(int argc, char ** argv, param_t * cmd_params)
                 // TODO Allow register size and cacheline size
                 cmd_params->bloom_filter_args.B = atoi(optarg);
                 break;
+            case 'P':
+                if (strcmp(optarg, "local") == 0)
+                    cmd_params->bloom_filter_args.placement = PASS2_LOCAL;
+                else if (strcmp(optarg, "global") == 0)
+                    cmd_params->bloom_filter_args.placement = PASS1_GLOBAL;
+                else {
+                    printf("[ERROR] Filter placement `%s' does not exist!\n",
+                           optarg);
+                    print_help(argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'T':
+                cmd_params->bloom_filter_args.bypass_threshold = atof(optarg);
+                break;
+            case 'W':
+                cmd_params->bloom_filter_args.save_path = mystrdup(optarg);
+                break;
+            case 'L':
+                cmd_params->bloom_filter_args.load_path = mystrdup(optarg);
+                break;
+            case 'F':
+                cmd_params->bloom_filter_args.prefilter_m = atoll(optarg);
+                break;
+            case 'K':
+                cmd_params->bloom_filter_args.prefilter_k = atoi(optarg);
+                break;
+            case 'H':
+                if (strcmp(optarg, "crc") == 0)
+                    cmd_params->bloom_filter_args.hash = HASH_CRC;
+                else if (strcmp(optarg, "murmur") == 0)
+                    cmd_params->bloom_filter_args.hash = HASH_MURMUR;
+                else if (strcmp(optarg, "mulshift") == 0)
+                    cmd_params->bloom_filter_args.hash = HASH_MULSHIFT;
+                else if (strcmp(optarg, "crapwow") == 0)
+                    cmd_params->bloom_filter_args.hash = HASH_CRAPWOW;
+                else {
+                    printf("[ERROR] Hash family `%s' does not exist!\n",
+                           optarg);
+                    print_help(argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                break;
             default:
                 break;
         }
@@ -719,6 +861,12 @@ parse_args(int argc, char ** argv, param_t * cmd_params)
     cmd_params->fullrange_keys = fullrange_flag;
     cmd_params->basic_numa     = basic_numa;
 
+    cmd_params->bloom_filter_args.local_build = bloom_local_build;
+    cmd_params->bloom_filter_args.replicate   = bloom_replicate;
+    cmd_params->bloom_filter_args.semi_join   = bloom_semi_join;
+    cmd_params->bloom_filter_args.prune       = bloom_prune;
+    cmd_params->bloom_filter_args.adaptive_pass2 = bloom_adaptive_pass2;
+
     /* Print any remaining command line arguments (not options). */
     if (optind < argc) {
         printf("non-option arguments: ");
@@ -727,5 +875,6 @@ parse_args(int argc, char ** argv, param_t * cmd_params)
         printf("\n");
     }
 
-    if (cmd_params->bloom_enable) assert_args(&cmd_params->bloom_filter_args);
+    if (cmd_params->bloom_enable && !cmd_params->bloom_auto)
+        assert_args(&cmd_params->bloom_filter_args);
 }
@@ -21,6 +21,7 @@
 #include <sys/time.h>           /* gettimeofday */
 
 #include "no_partitioning_join.h"
+#include "bloom_filter.h"       /* bloom_filter_x */
 #include "npj_params.h"         /* constant parameters */
 #include "npj_types.h"          /* bucket_t, hashtable_t, bucket_buffer_t */
 #include "rdtsc.h"              /* startTimer, stopTimer */
@@ -95,6 +96,12 @@ struct arg_t {
     pthread_barrier_t * barrier;
     int64_t             num_results;
 
+    /* the filter of R that S is checked against, NULL without a filter */
+    bloom_filter_strategy_t * filter;
+    /* all of R, a static filter is built at once by thread-0 */
+    relation_t *              fullR;
+    uint64_t                  passedS, matchedS;
+
     /* results of the thread */
     threadresult_t * threadresult;
 
@@ -221,14 +228,25 @@ destroy_hashtable(hashtable_t * ht)
     free(ht);
 }
 
+/** Inserts a key into a filter and into its first tier, if it has one. */
+static inline void
+filter_add(const bloom_filter_strategy_t * filter, intkey_t key)
+{
+    filter->add(filter->filter, key);
+    if(filter->prefilter)
+        filter->prefilter->add(filter->prefilter->filter, key);
+}
+
 /** 
  * Single-thread hashtable build method, ht is pre-allocated.
  * 
  * @param ht hastable to be built
  * @param rel the build relation
+ * @param filter the keys are inserted into this filter as well, NULL if none
  */
 void 
-build_hashtable_st(hashtable_t *ht, relation_t *rel)
+build_hashtable_st(hashtable_t *ht, relation_t *rel,
+                   const bloom_filter_strategy_t * filter)
 {
     uint32_t i;
     const uint32_t hashmask = ht->hash_mask;
@@ -239,6 +257,9 @@ build_hashtable_st(hashtable_t *ht, relation_t *rel)
         bucket_t * curr, * nxt;
         int32_t idx = HASH(rel->tuples[i].key, hashmask, skipbits);
 
+        if(filter)
+            filter_add(filter, rel->tuples[i].key);
+
         /* copy the tuple to appropriate hash bucket */
         /* if full, follow nxt pointer to find correct place */
         curr = ht->buckets + idx;
@@ -266,6 +287,115 @@ build_hashtable_st(hashtable_t *ht, relation_t *rel)
     }
 }
 
+/** 
+ * Walks the bucket chain of an outer tuple, returns its num results.
+ * 
+ * @param b the bucket the key of the tuple hashes to
+ * @param tuple the probing outer tuple
+ * @param output chained tuple buffer to write join results, i.e. rid pairs.
+ * 
+ * @return number of matching tuples
+ */
+static inline int64_t
+probe_bucket(const bucket_t * b, const tuple_t * tuple, void * output)
+{
+    uint32_t j;
+    int64_t matches = 0;
+
+#ifdef JOIN_RESULT_MATERIALIZE
+    chainedtuplebuffer_t * chainedbuf = (chainedtuplebuffer_t *) output;
+#endif
+
+    do {
+        for(j = 0; j < b->count; j++) {
+            if(tuple->key == b->tuples[j].key){
+                matches ++;
+
+#ifdef JOIN_RESULT_MATERIALIZE
+                /* copy to the result buffer */
+                tuple_t * joinres = cb_next_writepos(chainedbuf);
+                joinres->key      = b->tuples[j].payload; /* R-rid */
+                joinres->payload  = tuple->payload;       /* S-rid */
+#endif
+            }
+        }
+
+        b = b->next;/* follow overflow pointer */
+    } while(b);
+
+    return matches;
+}
+
+/** 
+ * Probes the hashtable with the tuples of the outer relation that pass the
+ * filter. The tuples are checked in batches of BLOOM_BATCH_TUPLES, the
+ * positions of the passing ones are compacted and only their buckets are
+ * accessed.
+ * 
+ * @param ht hashtable to be probed
+ * @param rel the probing outer relation
+ * @param output chained tuple buffer to write join results, i.e. rid pairs.
+ * @param filter the filter of the inner relation
+ * @param passed [in,out] incremented by the number of passing tuples
+ * @param matched [in,out] incremented by the number of tuples with a match
+ * 
+ * @return number of matching tuples
+ */
+static int64_t
+probe_hashtable_filtered(hashtable_t *ht, relation_t *rel, void * output,
+                         const bloom_filter_strategy_t * filter,
+                         uint64_t * passed, uint64_t * matched)
+{
+    uint64_t sel[BLOOM_SEL_WORDS(BLOOM_BATCH_TUPLES)];
+    uint32_t pos[BLOOM_BATCH_TUPLES];
+    int64_t matches = 0;
+
+    const uint32_t hashmask = ht->hash_mask;
+    const uint32_t skipbits = ht->skip_bits;
+    const bloom_filter_strategy_t * pre = filter->prefilter;
+
+    for (uint64_t c = 0; c < rel->num_tuples; c += BLOOM_BATCH_TUPLES)
+    {
+        const tuple_t * batch = rel->tuples + c;
+        const uint32_t n = (rel->num_tuples - c < BLOOM_BATCH_TUPLES)
+                           ? rel->num_tuples - c : BLOOM_BATCH_TUPLES;
+        uint32_t npassed = 0;
+
+        /* the batch stays cache resident while it is checked */
+        bloom_selection_fill(sel, n);
+        if(pre)
+            pre->contains_batch(pre->filter, batch, n, sel);
+        filter->contains_batch(filter->filter, batch, n, sel);
+
+        for(uint32_t w = 0; w < BLOOM_SEL_WORDS(n); w++) {
+            uint64_t bits = sel[w];
+            while(bits) {
+                pos[npassed++] = w * 64 + __builtin_ctzll(bits);
+                bits &= bits - 1;
+            }
+        }
+        *passed += npassed;
+
+        for(uint32_t i = 0; i < npassed; i++) {
+#ifdef PREFETCH_NPJ
+            if(i + PREFETCH_DISTANCE < npassed) {
+                intkey_t idx_prefetch = HASH(batch[pos[i + PREFETCH_DISTANCE]].key,
+                                             hashmask, skipbits);
+                __builtin_prefetch(ht->buckets + idx_prefetch, 0, 1);
+            }
+#endif
+            const tuple_t * tuple = batch + pos[i];
+            intkey_t idx = HASH(tuple->key, hashmask, skipbits);
+            int64_t m = probe_bucket(ht->buckets + idx, tuple, output);
+
+            matches += m;
+            *matched += m > 0;
+        }
+    }
+
+    return matches;
+}
+
 /** 
  * Probes the hashtable for the given outer relation, returns num results. 
  * This probing method is used for both single and multi-threaded version.
@@ -273,15 +403,24 @@ build_hashtable_st(hashtable_t *ht, relation_t *rel)
  * @param ht hashtable to be probed
  * @param rel the probing outer relation
  * @param output chained tuple buffer to write join results, i.e. rid pairs.
+ * @param filter if not NULL, only tuples passing it probe the hashtable
+ * @param passed [in,out] number of tuples passing the filter
+ * @param matched [in,out] number of tuples with a match, counted with a filter
  * 
  * @return number of matching tuples
  */
 int64_t 
-probe_hashtable(hashtable_t *ht, relation_t *rel, void * output)
+probe_hashtable(hashtable_t *ht, relation_t *rel, void * output,
+                const bloom_filter_strategy_t * filter, uint64_t * passed,
+                uint64_t * matched)
 {
-    uint32_t i, j;
+    uint32_t i;
     int64_t matches;
 
+    if(filter)
+        return probe_hashtable_filtered(ht, rel, output, filter, passed,
+                                        matched);
+
     const uint32_t hashmask = ht->hash_mask;
     const uint32_t skipbits = ht->skip_bits;
 #ifdef PREFETCH_NPJ    
@@ -290,10 +429,6 @@ probe_hashtable(hashtable_t *ht, relation_t *rel, void * output)
     
     matches = 0;
 
-#ifdef JOIN_RESULT_MATERIALIZE
-    chainedtuplebuffer_t * chainedbuf = (chainedtuplebuffer_t *) output;
-#endif
-
     for (i = 0; i < rel->num_tuples; i++)
     {
 #ifdef PREFETCH_NPJ        
@@ -307,23 +442,7 @@ probe_hashtable(hashtable_t *ht, relation_t *rel, void * output)
         intkey_t idx = HASH(rel->tuples[i].key, hashmask, skipbits);
         bucket_t * b = ht->buckets+idx;
 
-        do {
-            for(j = 0; j < b->count; j++) {
-                if(rel->tuples[i].key == b->tuples[j].key){
-                    matches ++;
-
- #ifdef JOIN_RESULT_MATERIALIZE
-                    /* copy to the result buffer */
-                    tuple_t * joinres = cb_next_writepos(chainedbuf);
-                    joinres->key      = b->tuples[j].payload;   /* R-rid */
-                    joinres->payload  = rel->tuples[i].payload; /* S-rid */
-#endif
-                   
-                }
-            }
-
-            b = b->next;/* follow overflow pointer */
-        } while(b);
+        matches += probe_bucket(b, rel->tuples + i, output);
     }
 
     return matches;
@@ -355,13 +474,55 @@ print_timing(uint64_t total, uint64_t build, uint64_t part,
     fflush(stdout);
 }
 
-/** \copydoc NPO_st */
-result_t *
-NPO_st(relation_t *relR, relation_t *relS, int nthreads)
+/** 
+ * Creates the filter of R for the bloom variants, S is checked against it
+ * before the hashtable is probed.
+ *
+ * @param bloom_filter_args the filter options, NULL for no filter
+ * 
+ * @return the empty filter, NULL for no filter
+ */
+static bloom_filter_strategy_t *
+npo_filter_create(bloom_filter_args_t * bloom_filter_args)
+{
+    bloom_filter_args_t args;
+
+    if(!bloom_filter_args)
+        return NULL;
+
+    /* there is no partitioning, so S is always checked against one filter */
+    args            = *bloom_filter_args;
+    args.lazy_clear = false;
+    return bloom_filter_create(&args, 42);
+}
+
+/** 
+ * Prints how many tuples of S passed the filter and how well it worked, then
+ * frees the filter.
+ */
+static void
+npo_filter_report(bloom_filter_strategy_t * filter, relation_t *relR,
+                  relation_t *relS, uint64_t passed, uint64_t matched)
+{
+    fprintf(stdout, "S-tuples after filter: %lu\n", passed);
+    bloom_filter_print_health(filter, relR->num_tuples, relS->num_tuples,
+                              passed, matched,
+                              bloom_filter_popcount(filter->filter, 0,
+                                                    filter->filter->m / 8));
+    bloom_filter_destroy(filter);
+}
+
+/** 
+ * The single-threaded NPO, with a filter if bloom_filter_args is given.
+ */
+static result_t *
+npo_st(relation_t *relR, relation_t *relS, bloom_filter_args_t * bloom_filter_args)
 {
     hashtable_t * ht;
     int64_t result = 0;
     result_t * joinresult;
+    uint64_t passed = 0, matched = 0;
+    bloom_filter_strategy_t * filter = npo_filter_create(bloom_filter_args);
 
 #ifndef NO_TIMING
     struct timeval start, probe_start, end;
@@ -382,7 +543,13 @@ NPO_st(relation_t *relR, relation_t *relS, int nthreads)
     timer3 = 0; /* no partitioning */
 #endif
 
-    build_hashtable_st(ht, relR);
+    /* a static filter is built at once from all keys */
+    if(filter && bloom_filter_is_static(filter)) {
+        bloom_filter_build(filter, relR->tuples, relR->num_tuples);
+        build_hashtable_st(ht, relR, NULL);
+    }
+    else
+        build_hashtable_st(ht, relR, filter);
 
 #ifndef NO_TIMING
     stopTimer(&timer2); /* for build */
@@ -395,7 +562,7 @@ NPO_st(relation_t *relR, relation_t *relS, int nthreads)
     void * chainedbuf = NULL;
 #endif
 
-    result = probe_hashtable(ht, relS, chainedbuf);
+    result = probe_hashtable(ht, relS, chainedbuf, filter, &passed, &matched);
 
 #ifdef JOIN_RESULT_MATERIALIZE
     threadresult_t * thrres = &(joinresult->resultlist[0]);/* single-thread */
@@ -413,6 +580,9 @@ NPO_st(relation_t *relR, relation_t *relS, int nthreads)
     print_timing(timer1, timer2, timer3, relS->num_tuples, result, &start, probe_usec, &end);
 #endif
 
+    if(filter)
+        npo_filter_report(filter, relR, relS, passed, matched);
+
     destroy_hashtable(ht);
 
     joinresult->totalresults = result;
@@ -421,6 +591,21 @@ NPO_st(relation_t *relR, relation_t *relS, int nthreads)
     return joinresult;
 }
 
+/** \copydoc NPO_st */
+result_t *
+NPO_st(relation_t *relR, relation_t *relS, int nthreads)
+{
+    return npo_st(relR, relS, NULL);
+}
+
+/** \copydoc BNPO_st */
+result_t *
+BNPO_st(relation_t *relR, relation_t *relS, int nthreads,
+        bloom_filter_args_t * bloom_filter_args)
+{
+    return npo_st(relR, relS, bloom_filter_args);
+}
+
 /** 
  * Multi-thread hashtable build method, ht is pre-allocated.
  * Writes to buckets are synchronized via latches.
@@ -428,10 +613,12 @@ NPO_st(relation_t *relR, relation_t *relS, int nthreads)
  * @param ht hastable to be built
  * @param rel the build relation
  * @param overflowbuf pre-allocated chunk of buckets for overflow use.
+ * @param filter the keys are inserted into this filter as well, NULL if none
  */
 void 
 build_hashtable_mt(hashtable_t *ht, relation_t *rel, 
-                   bucket_buffer_t ** overflowbuf)
+                   bucket_buffer_t ** overflowbuf,
+                   const bloom_filter_strategy_t * filter)
 {
     uint32_t i;
     const uint32_t hashmask = ht->hash_mask;
@@ -454,6 +641,11 @@ build_hashtable_mt(hashtable_t *ht, relation_t *rel,
 #endif
         
         int32_t idx = HASH(rel->tuples[i].key, hashmask, skipbits);
+
+        /* the filter bits are set atomically, outside of the latch */
+        if(filter)
+            filter_add(filter, rel->tuples[i].key);
+
         /* copy the tuple to appropriate hash bucket */
         /* if full, follow nxt pointer to find correct place */
         curr = ht->buckets+idx;
@@ -524,8 +716,17 @@ npo_thread(void * param)
     }
 #endif
 
-    /* insert tuples from the assigned part of relR to the ht */
-    build_hashtable_mt(args->ht, &args->relR, &overflowbuf);
+    /* a static filter is built at once from all of relR by thread-0 */
+    if(args->filter && bloom_filter_is_static(args->filter)) {
+        if(args->tid == 0)
+            bloom_filter_build(args->filter, args->fullR->tuples,
+                               args->fullR->num_tuples);
+        build_hashtable_mt(args->ht, &args->relR, &overflowbuf, NULL);
+    }
+    else {
+        /* insert tuples from the assigned part of relR to the ht */
+        build_hashtable_mt(args->ht, &args->relR, &overflowbuf, args->filter);
+    }
 
     /* wait at a barrier until each thread completes build phase */
     BARRIER_ARRIVE(args->barrier, rv);
@@ -557,7 +758,9 @@ npo_thread(void * param)
 #endif
 
     /* probe for matching tuples from the assigned part of relS */
-    args->num_results = probe_hashtable(args->ht, &args->relS, chainedbuf);
+    args->num_results = probe_hashtable(args->ht, &args->relS, chainedbuf,
+                                        args->filter, &args->passedS,
+                                        &args->matchedS);
 
 #ifdef JOIN_RESULT_MATERIALIZE
     args->threadresult->nresults = args->num_results;
@@ -594,10 +797,15 @@ npo_thread(void * param)
     return 0;
 }
 
-/** \copydoc NPO */
-result_t *
-NPO(relation_t *relR, relation_t *relS, int nthreads)
+/** 
+ * The multi-threaded NPO, with a filter if bloom_filter_args is given.
+ */
+static result_t *
+npo(relation_t *relR, relation_t *relS, int nthreads,
+    bloom_filter_args_t * bloom_filter_args)
 {
+    bloom_filter_strategy_t * filter = npo_filter_create(bloom_filter_args);
+    uint64_t passed = 0, matched = 0;
     hashtable_t * ht;
     int64_t result = 0;
     int32_t numR, numS, numRthr, numSthr; /* total and per thread num */
@@ -656,6 +864,11 @@ NPO(relation_t *relR, relation_t *relS, int nthreads)
 
         args[i].threadresult = &(joinresult->resultlist[i]);
 
+        args[i].filter   = filter;
+        args[i].fullR    = relR;
+        args[i].passedS  = 0;
+        args[i].matchedS = 0;
+
         rv = pthread_create(&tid[i], &attr, npo_thread, (void*)&args[i]);
         if (rv){
             printf("ERROR; return code from pthread_create() is %d\n", rv);
@@ -668,6 +881,8 @@ NPO(relation_t *relR, relation_t *relS, int nthreads)
         pthread_join(tid[i], NULL);
         /* sum up results */
         result += args[i].num_results;
+        passed += args[i].passedS;
+        matched += args[i].matchedS;
     }
     joinresult->totalresults = result;
     joinresult->nthreads     = nthreads;
@@ -682,9 +897,27 @@ NPO(relation_t *relR, relation_t *relS, int nthreads)
                  result, &args[0].start, probe_usec, &args[0].end);
 #endif
 
+    if(filter)
+        npo_filter_report(filter, relR, relS, passed, matched);
+
     destroy_hashtable(ht);
 
     return joinresult;
 }
 
+/** \copydoc NPO */
+result_t *
+NPO(relation_t *relR, relation_t *relS, int nthreads)
+{
+    return npo(relR, relS, nthreads, NULL);
+}
+
+/** \copydoc BNPO */
+result_t *
+BNPO(relation_t *relR, relation_t *relS, int nthreads,
+     bloom_filter_args_t * bloom_filter_args)
+{
+    return npo(relR, relS, nthreads, bloom_filter_args);
+}
+
 /** @}*/
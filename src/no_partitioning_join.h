@@ -13,6 +13,7 @@
 #ifndef NO_PARTITIONING_JOIN_H
 #define NO_PARTITIONING_JOIN_H
 
+#include "bloom_filter.h" /* bloom_filter_args_t */
 #include "types.h" /* relation_t */
 
 /** 
@@ -44,5 +45,35 @@ NPO(relation_t *relR, relation_t *relS, int nthreads);
 result_t *
 NPO_st(relation_t *relR, relation_t *relS, int nthreads);
 
+/** 
+ * NPO with a filter: the keys of R are inserted into the filter while the
+ * hashtable is built and S probes the hashtable only with the tuples that
+ * pass the filter. Static filters are built from all of R at once. The
+ * filter is given by -b, -m, -k, -B, -F, -K and -H, the options for
+ * partitioning, replicating, saving and loading it do not apply.
+ *
+ * @param relR input relation R - inner relation
+ * @param relS input relation S - outer relation
+ * @param bloom_filter_args the parameters of the filter
+ * 
+ * @return number of result tuples
+ */
+result_t *
+BNPO(relation_t *relR, relation_t *relS, int nthreads,
+     bloom_filter_args_t * bloom_filter_args);
+
+/** 
+ * The single-threaded NPO with a filter, see BNPO.
+ * 
+ * @param relR input relation R - inner relation
+ * @param relS input relation S - outer relation
+ * @param bloom_filter_args the parameters of the filter
+ * 
+ * @return number of result tuples
+ */
+result_t *
+BNPO_st(relation_t *relR, relation_t *relS, int nthreads,
+        bloom_filter_args_t * bloom_filter_args);
+
 
 #endif /* NO_PARTITIONING_JOIN_H */
@@ -17,6 +17,9 @@
 #include <sched.h>   /* CPU_ZERO, CPU_SET */
 #if defined(__i386__) || defined(__x86_64__)
 #include <smmintrin.h> /* simd only for 32-bit keys – SSE4.1 */
+#ifdef __AVX__
+#include <immintrin.h> /* __m256i of --enable-avx2 */
+#endif
 #else
 #include "sse2neon.h"
 #endif
@@ -69,6 +72,14 @@
 /* #define RADIX_HASH(V)  ((V>>7)^(V>>13)^(V>>21)^V) */
 #define HASH_BIT_MODULO(K, MASK, NBITS) (((K) & MASK) >> NBITS)
 
+/**
+ * 16-bit fingerprint of a key for the tagged bucket chains, taken from the
+ * high bits of a multiplicative hash so that it is independent of the key bits
+ * used for the radix partitioning and the bucket index.
+ */
+#define BUCKET_TAG(K) \
+    ((uint16_t) (((uint64_t) (K) * 0x9e3779b97f4a7c15ULL) >> 48))
+
 #ifndef NEXT_POW_2
 /** 
  *  compute the next number, greater than or equal to 32-bit unsigned v.
@@ -324,6 +335,87 @@ bucket_chaining_join(const relation_t * const R, const relation_t * const S,
     return matches;
 }
 
+/**
+ * Variant of bucket_chaining_join() that keeps a 16-bit fingerprint of each
+ * R-tuple in tag[], parallel to next[]. A probe only loads an R-tuple from
+ * Rtuples when its fingerprint matches the one of the S-key, so non-matching
+ * S-tuples and long chains of --non-unique keys mostly touch the 6 bytes of
+ * next[] and tag[] per link, not a whole tuple.
+ *
+ * @param R input relation R
+ * @param S input relation S
+ * @param output join results, if JOIN_RESULT_MATERIALIZE defined.
+ *
+ * @return number of result tuples
+ */
+static int64_t
+bucket_chaining_tagged_join(const relation_t * const R,
+                            const relation_t * const S,
+                            relation_t * const tmpR, void * output,
+                            uint64_t *       probe_cycles,
+                            struct timeval * probe_time_total)
+{
+    int *          next, *bucket;
+    uint16_t *     tag;
+    const uint32_t numR    = R->num_tuples;
+    uint32_t       N       = numR;
+    int64_t        matches = 0;
+    struct timeval probe_start, probe_end, probe;
+
+    NEXT_POW_2(N);
+    const uint32_t MASK = (N - 1) << (NUM_RADIX_BITS);
+
+    next   = (int *) malloc(sizeof(int) * numR);
+    tag    = (uint16_t *) malloc(sizeof(uint16_t) * numR);
+    bucket = (int *) calloc(N, sizeof(int));
+
+    const tuple_t * const Rtuples = R->tuples;
+    for (uint32_t i = 0; i < numR;) {
+        uint32_t idx = HASH_BIT_MODULO(Rtuples[i].key, MASK, NUM_RADIX_BITS);
+        tag[i]       = BUCKET_TAG(Rtuples[i].key);
+        next[i]      = bucket[idx];
+        bucket[idx]  = ++i; /* pos's start from 1 */
+    }
+
+    gettimeofday(&probe_start, NULL);
+    resumeTimer(probe_cycles);
+    const tuple_t * const Stuples = S->tuples;
+    const uint32_t        numS    = S->num_tuples;
+
+#ifdef JOIN_RESULT_MATERIALIZE
+    chainedtuplebuffer_t * chainedbuf = (chainedtuplebuffer_t *) output;
+#endif
+
+    for (uint32_t i = 0; i < numS; i++) {
+        uint32_t idx = HASH_BIT_MODULO(Stuples[i].key, MASK, NUM_RADIX_BITS);
+        uint16_t fp  = BUCKET_TAG(Stuples[i].key);
+
+        for (int hit = bucket[idx]; hit > 0; hit = next[hit - 1]) {
+            if (tag[hit - 1] == fp &&
+                Stuples[i].key == Rtuples[hit - 1].key) {
+
+#ifdef JOIN_RESULT_MATERIALIZE
+                tuple_t * joinres = cb_next_writepos(chainedbuf);
+                joinres->key      = Rtuples[hit - 1].payload; /* R-rid */
+                joinres->payload  = Stuples[i].payload;       /* S-rid */
+#endif
+
+                matches++;
+            }
+        }
+    }
+    stopTimer(probe_cycles);
+    gettimeofday(&probe_end, NULL);
+    timersub(&probe_end, &probe_start, &probe);
+    timeradd(&probe, probe_time_total, probe_time_total);
+
+    free(bucket);
+    free(tag);
+    free(next);
+
+    return matches;
+}
+
 /** computes and returns the histogram size for join */
 inline uint32_t
 get_hist_size(uint32_t relSize) __attribute__((always_inline));
@@ -1699,6 +1791,13 @@ PRO(relation_t * relR, relation_t * relS, int nthreads)
     return join_init_run(relR, relS, bucket_chaining_join, nthreads);
 }
 
+/** \copydoc PROT */
+result_t *
+PROT(relation_t * relR, relation_t * relS, int nthreads)
+{
+    return join_init_run(relR, relS, bucket_chaining_tagged_join, nthreads);
+}
+
 /** \copydoc PRH */
 result_t *
 PRH(relation_t * relR, relation_t * relS, int nthreads)
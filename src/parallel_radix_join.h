@@ -33,6 +33,22 @@
 result_t *
 PRO(relation_t * relR, relation_t * relS, int nthreads);
 
+/**
+ * PROT: Parallel Radix Join Optimized with Tagged buckets.
+ *
+ * Same as PRO, but every link of the bucket chains carries a 16-bit
+ * fingerprint of the R-tuple it points to. Probes skip the R-tuples whose
+ * fingerprint differs from the one of the S-key, which shortens the walk over
+ * long chains of non-unique keys and over chains probed by non-matching keys.
+
+ * @param relR  input relation R - inner relation
+ * @param relS  input relation S - inner relation
+ *
+ * @return number of result tuples
+ */
+result_t *
+PROT(relation_t * relR, relation_t * relS, int nthreads);
+
 /**
  * RJ: Radix Join.
  *
@@ -17,14 +17,18 @@
 #include <sched.h>   /* CPU_ZERO, CPU_SET */
 #if defined(__i386__) || defined(__x86_64__)
 #include <smmintrin.h> /* simd only for 32-bit keys – SSE4.1 */
+#ifdef __AVX__
+#include <immintrin.h> /* __m256i of --enable-avx2 */
+#endif
 #else
 #include "sse2neon.h"
 #endif
 #include <stdio.h>    /* printf */
 #include <stdlib.h>   /* malloc, posix_memalign */
+#include <string.h>   /* memset */
 #include <sys/time.h> /* gettimeofday */
 
-#include "cpu_mapping.h" /* get_cpu_id */
+#include "cpu_mapping.h" /* get_cpu_id, get_cache_size */
 #include "parallel_radix_join_bloom.h"
 #include "prj_params.h" /* constant parameters */
 #include "rdtsc.h"      /* startTimer, stopTimer */
@@ -46,6 +50,7 @@
 #include <math.h>
 
 #include "bloom_filter.h"
+#include "bloom_filter_kernels.h"
 
 /** \internal */
 // clang-format off
@@ -73,6 +78,14 @@
 /* #define RADIX_HASH(V)  ((V>>7)^(V>>13)^(V>>21)^V) */
 #define HASH_BIT_MODULO(K, MASK, NBITS) (((K) & MASK) >> NBITS)
 
+/**
+ * 16-bit fingerprint of a key for the tagged bucket chains, taken from the
+ * high bits of a multiplicative hash so that it is independent of the key bits
+ * used for the radix partitioning and the bucket index.
+ */
+#define BUCKET_TAG(K) \
+    ((uint16_t) (((uint64_t) (K) * 0x9e3779b97f4a7c15ULL) >> 48))
+
 #ifndef NEXT_POW_2
 /** 
  *  compute the next number, greater than or equal to 32-bit unsigned v.
@@ -91,7 +104,30 @@
     } while(0)
 #endif
 
+/**
+ * Share of L2 that the hash table of a pass-2 partition of R may take with an
+ * adaptive pass-2 fanout (--bloom-adaptive-pass2), as 1 / PASS2_L2_SHARE. An
+ * R-tuple takes sizeof(tuple_t) plus an int of next[] and, as the buckets are
+ * rounded up to a power of 2 of at most twice the tuples, about one int of
+ * buckets. The rest of L2 is left to the S-tuples streamed through the table
+ * and to the output: with half of a 2 MiB L2, the joins were slower than
+ * with a quarter.
+ */
+#ifndef PASS2_L2_SHARE
+#define PASS2_L2_SHARE 4
+#endif
+
 #define MAX(X, Y) (((X) > (Y)) ? (X) : (Y))
+#define MIN(X, Y) (((X) < (Y)) ? (X) : (Y))
+
+/** bounds of intkey_t, an empty key range starts as [INTKEY_MAX, INTKEY_MIN] */
+#ifdef KEY_8B
+#define INTKEY_MIN INT64_MIN
+#define INTKEY_MAX INT64_MAX
+#else
+#define INTKEY_MIN INT32_MIN
+#define INTKEY_MAX INT32_MAX
+#endif
 
 #ifdef SYNCSTATS
 #define SYNC_TIMERS_START(A, TID)               \
@@ -142,7 +178,49 @@ typedef struct part_t      part_t;
 typedef struct synctimer_t synctimer_t;
 typedef int64_t (*JoinFunction)(
     const relation_t * const, const relation_t * const, relation_t * const,
-    void * output, uint64_t * probe_cycles, struct timeval * probe_time_total);
+    int32_t radixbits, void * scratch, void * output, uint64_t * probe_cycles,
+    struct timeval * probe_time_total, uint64_t * matchedS);
+
+/**
+ * Key range of R in each pass-1 partition. The S-tuples outside the range of
+ * their partition cannot have a match and are dropped before the filter.
+ */
+typedef struct {
+    /** min and max key of each partition, min > max if it is empty */
+    intkey_t (*range)[2];
+    /** S-tuples dropped by the ranges */
+    uint64_t pruned;
+} partition_ranges_t;
+
+/**
+ * Scans the tuples of a relation in a partitioning pass: inserts their keys
+ * into the filter or checks them against it depending on the usage, and counts
+ * the (selected) tuples in the histogram.
+ *
+ * @param strategy the filter to insert into or check against
+ * @param rel the tuples to scan
+ * @param num_tuples the number of tuples
+ * @param usage INSERT, CHECK or IGNORE the filter
+ * @param selected [in/out] the selection bitmap of the tuples, negatives are
+ * deselected by CHECK
+ * @param dense [out] if not NULL, CHECK copies the tuples that pass to it, so
+ * they are counted and scattered without reading rel again. Needs room for
+ * num_tuples + BLOOM_COMPACT_PADDING tuples.
+ * @param ranges [in/out] if not NULL, CHECK first deselects the tuples outside
+ * the key range of their partition and counts them
+ * @param hist the histogram to count the tuples in
+ * @param MASK radix mask of the pass
+ * @param R radix shift of the pass
+ * @return the number of tuples that passed the first tier of the filter, all
+ * tuples if it has none or is not checked
+ */
+typedef uint64_t (*FilterScanFunction)(const bloom_filter_strategy_t * strategy,
+                                       const tuple_t * rel, uint32_t num_tuples,
+                                       bloom_filter_usage_t usage,
+                                       uint64_t * selected, tuple_t * dense,
+                                       partition_ranges_t * ranges,
+                                       int32_t * hist, uint32_t MASK,
+                                       int32_t R);
 
 #ifdef SYNCSTATS
 /** holds syncronization timing stats if configured with --enable-syncstats */
@@ -166,6 +244,10 @@ struct arg_t {
     int32_t ** histS;
     tuple_t *  relS;
     tuple_t *  tmpS;
+    /** where pass-2 writes its partitions, relR and relS of thread 0 or, for
+        an adaptive fanout, buffers with PASS2_MAX_RELATION_PADDING */
+    tuple_t * pass2R;
+    tuple_t * pass2S;
 
     int32_t numR;
     int32_t numS;
@@ -173,6 +255,53 @@ struct arg_t {
     int64_t totalS;
 
     bloom_filter_strategy_t * bloom_filter_strategy;
+    FilterScanFunction        filter_scan;
+    /** filter R is inserted into, thread-local if the filter is built locally */
+    bloom_filter_strategy_t * build_filter_strategy;
+    /** the thread-local filters of all threads, NULL for a shared build */
+    bloom_filter_strategy_t ** local_filter_strategies;
+    /** the global filter was loaded from a file and R is not inserted */
+    bool filter_loaded;
+    /** filter of the S-tuples passing pass-1 that R is checked against in
+        pass-2, NULL without semi-join reduction of R */
+    bloom_filter_strategy_t * semi_filter_strategy;
+    FilterScanFunction        semi_filter_scan;
+    /** R-tuples of this thread removed by the semi-join filter */
+    uint64_t removedR;
+    /** pass-2 partition pairs of this thread to be joined and the join tasks
+        they were coalesced into */
+    uint64_t joinpairs, jointasks;
+    /** R-tuples of a pass-2 partition whose hash table fits L2, 0 for the
+        fixed PASS2RADIXBITS, and the pass-1 partitions of this thread by the
+        pass-2 radix bits chosen */
+    uint64_t pass2_target;
+    uint64_t pass2_fanouts[PASS2_MAX_RADIXBITS + 1];
+    /** min and max key of R of each thread, allocated for an exact filter */
+    intkey_t (*key_ranges)[2];
+    /** min and max key of R of each thread in each pass-1 partition,
+        FANOUT_PASS1 per thread, allocated for partition pruning */
+    intkey_t (*thread_part_ranges)[2];
+    /** key ranges of the pass-1 partitions of R over all threads that S is
+        pruned by, range is NULL without partition pruning */
+    partition_ranges_t part_ranges;
+    /** S-tuples checked against the global filter, passing its first tier
+        and passing both tiers */
+    uint64_t checked, prefilter_passed, filter_passed;
+    /** S-tuples of the join tasks of this thread with at least one match */
+    uint64_t matchedS;
+    /** bits set in the share of the global filter counted by this thread */
+    uint64_t filter_bits;
+    /** per NUMA-node copies of the global filter, NULL if not replicated */
+    bloom_filter_strategy_t ** filter_replicas;
+    /** filter of the pass-2 partition at hand, NULL for a pass-1 filter */
+    bloom_filter_strategy_t * partition_filter_strategy;
+    bloom_filter_placement_t  filter_placement;
+    /** S-tuples that passed the partition-local filters of this thread */
+    uint64_t filtered;
+    /** adaptive bypass: threshold, pass rate of the sample and decision */
+    double bypass_threshold;
+    double sampled_pass_rate;
+    bool   bypassed;
 
     task_queue_t ** join_queue;
     task_queue_t ** part_queue;
@@ -192,6 +321,11 @@ struct arg_t {
     /* stats about the thread */
     int32_t        parts_processed;
     uint64_t       timer1, timer2, timer3;
+    uint64_t       filter_build_timer, filter_merge_timer;
+    uint64_t       filter_replicate_timer;
+    /** time of this thread in filter scans that insert into or check against
+        the global filter, the scans also count the histogram */
+    uint64_t filter_add_timer, filter_check_timer;
     struct timeval start, partitioned, probe, end;
 #ifdef SYNCSTATS
     /** Thread local timers : */
@@ -219,6 +353,8 @@ struct part_t {
     uint32_t   D;
     int        relidx; /* 0: R, 1: S */
     uint32_t   padding;
+    bloom_filter_usage_t usage; /* INSERT, CHECK or IGNORE the filter */
+    intkey_t (*ranges)[2]; /* key range of each partition is tracked, or NULL */
 } __attribute__((aligned(CACHE_LINE_SIZE)));
 
 static void *
@@ -252,14 +388,20 @@ alloc_aligned(size_t size)
  *
  * @param R input relation R
  * @param S input relation S
+ * @param radixbits low key bits R and S are partitioned by, the hash table
+ *        indexes the bits above them
+ * @param scratch join_scratch_size(|R|) bytes for the hash table or NULL to
+ *        allocate it
  * @param output join results, if JOIN_RESULT_MATERIALIZE defined.
+ * @param matchedS [out] incremented by the number of S-tuples with a match
  *
  * @return number of result tuples
  */
 static int64_t
 bucket_chaining_join(const relation_t * const R, const relation_t * const S,
-                     relation_t * const tmpR, void * output,
-                     uint64_t * probe_cycles, struct timeval * probe_time_total)
+                     relation_t * const tmpR, int32_t radixbits,
+                     void * scratch, void * output, uint64_t * probe_cycles,
+                     struct timeval * probe_time_total, uint64_t * matchedS)
 {
     int *          next, *bucket;
     const uint32_t numR    = R->num_tuples;
@@ -269,15 +411,17 @@ bucket_chaining_join(const relation_t * const R, const relation_t * const S,
 
     NEXT_POW_2(N);
     /* N <<= 1; */
-    const uint32_t MASK = (N - 1) << (NUM_RADIX_BITS);
+    const uint32_t MASK = (N - 1) << radixbits;
 
-    next = (int *) malloc(sizeof(int) * numR);
+    void * mem = scratch ? scratch : malloc(sizeof(int) * (N + numR));
     /* posix_memalign((void**)&next, CACHE_LINE_SIZE, numR * sizeof(int)); */
-    bucket = (int *) calloc(N, sizeof(int));
+    bucket = (int *) mem;
+    next   = bucket + N;
+    memset(bucket, 0, N * sizeof(int));
 
     const tuple_t * const Rtuples = R->tuples;
     for (uint32_t i = 0; i < numR;) {
-        uint32_t idx = HASH_BIT_MODULO(R->tuples[i].key, MASK, NUM_RADIX_BITS);
+        uint32_t idx = HASH_BIT_MODULO(R->tuples[i].key, MASK, radixbits);
         next[i]      = bucket[idx];
         bucket[idx]  = ++i; /* we start pos's from 1 instead of 0 */
 
@@ -295,10 +439,14 @@ bucket_chaining_join(const relation_t * const R, const relation_t * const S,
     chainedtuplebuffer_t * chainedbuf = (chainedtuplebuffer_t *) output;
 #endif
 
+    /* S-tuples without a match passed the filter as false positives */
+    uint64_t matched = 0;
+
     /* Disable the following loop for no-probe for the break-down experiments */
     /* PROBE- LOOP */
     for (uint32_t i = 0; i < numS; i++) {
-        uint32_t idx = HASH_BIT_MODULO(Stuples[i].key, MASK, NUM_RADIX_BITS);
+        uint32_t idx = HASH_BIT_MODULO(Stuples[i].key, MASK, radixbits);
+        const int64_t before = matches;
 
         for (int hit = bucket[idx]; hit > 0; hit = next[hit - 1]) {
 
@@ -314,7 +462,9 @@ bucket_chaining_join(const relation_t * const R, const relation_t * const S,
                 matches++;
             }
         }
+        matched += matches != before;
     }
+    *matchedS += matched;
     stopTimer(probe_cycles);
     gettimeofday(&probe_end, NULL);
     timersub(&probe_end, &probe_start, &probe);
@@ -322,8 +472,103 @@ bucket_chaining_join(const relation_t * const R, const relation_t * const S,
     /* PROBE-LOOP END  */
 
     /* clean up temp */
-    free(bucket);
-    free(next);
+    if (!scratch) free(mem);
+
+    return matches;
+}
+
+/**
+ * Variant of bucket_chaining_join() that keeps a 16-bit fingerprint of each
+ * R-tuple in tag[], parallel to next[]. A probe only loads an R-tuple from
+ * Rtuples when its fingerprint matches the one of the S-key, so non-matching
+ * S-tuples (e.g. filter false positives) and long chains of --non-unique keys
+ * mostly touch the 6 bytes of next[] and tag[] per link, not a whole tuple.
+ *
+ * @param R input relation R
+ * @param S input relation S
+ * @param radixbits low key bits R and S are partitioned by, the hash table
+ *        indexes the bits above them
+ * @param scratch join_scratch_size(|R|) bytes for the hash table or NULL to
+ *        allocate it
+ * @param output join results, if JOIN_RESULT_MATERIALIZE defined.
+ * @param matchedS [out] incremented by the number of S-tuples with a match
+ *
+ * @return number of result tuples
+ */
+static int64_t
+bucket_chaining_tagged_join(const relation_t * const R,
+                            const relation_t * const S,
+                            relation_t * const tmpR, int32_t radixbits,
+                            void * scratch, void * output,
+                            uint64_t *       probe_cycles,
+                            struct timeval * probe_time_total,
+                            uint64_t *       matchedS)
+{
+    int *          next, *bucket;
+    uint16_t *     tag;
+    const uint32_t numR    = R->num_tuples;
+    uint32_t       N       = numR;
+    int64_t        matches = 0;
+    struct timeval probe_start, probe_end, probe;
+
+    NEXT_POW_2(N);
+    const uint32_t MASK = (N - 1) << radixbits;
+
+    void * mem = scratch ? scratch
+                         : malloc(sizeof(int) * (N + numR)
+                                  + sizeof(uint16_t) * numR);
+    bucket     = (int *) mem;
+    next       = bucket + N;
+    tag        = (uint16_t *) (next + numR);
+    memset(bucket, 0, N * sizeof(int));
+
+    const tuple_t * const Rtuples = R->tuples;
+    for (uint32_t i = 0; i < numR;) {
+        uint32_t idx = HASH_BIT_MODULO(Rtuples[i].key, MASK, radixbits);
+        tag[i]       = BUCKET_TAG(Rtuples[i].key);
+        next[i]      = bucket[idx];
+        bucket[idx]  = ++i; /* pos's start from 1 */
+    }
+
+    gettimeofday(&probe_start, NULL);
+    resumeTimer(probe_cycles);
+    const tuple_t * const Stuples = S->tuples;
+    const uint32_t        numS    = S->num_tuples;
+
+#ifdef JOIN_RESULT_MATERIALIZE
+    chainedtuplebuffer_t * chainedbuf = (chainedtuplebuffer_t *) output;
+#endif
+
+    /* S-tuples without a match passed the filter as false positives */
+    uint64_t matched = 0;
+
+    for (uint32_t i = 0; i < numS; i++) {
+        uint32_t idx = HASH_BIT_MODULO(Stuples[i].key, MASK, radixbits);
+        uint16_t fp  = BUCKET_TAG(Stuples[i].key);
+        const int64_t before = matches;
+
+        for (int hit = bucket[idx]; hit > 0; hit = next[hit - 1]) {
+            if (tag[hit - 1] == fp &&
+                Stuples[i].key == Rtuples[hit - 1].key) {
+
+#ifdef JOIN_RESULT_MATERIALIZE
+                tuple_t * joinres = cb_next_writepos(chainedbuf);
+                joinres->key      = Rtuples[hit - 1].payload; /* R-rid */
+                joinres->payload  = Stuples[i].payload;       /* S-rid */
+#endif
+
+                matches++;
+            }
+        }
+        matched += matches != before;
+    }
+    *matchedS += matched;
+    stopTimer(probe_cycles);
+    gettimeofday(&probe_end, NULL);
+    timersub(&probe_end, &probe_start, &probe);
+    timeradd(&probe, probe_time_total, probe_time_total);
+
+    if (!scratch) free(mem);
 
     return matches;
 }
@@ -341,6 +586,20 @@ get_hist_size(uint32_t relSize)
     return relSize;
 }
 
+/**
+ * Bytes of hash table any of the join functions needs for numR R-tuples, the
+ * links and tags of bucket_chaining_tagged_join() being the largest. A task of
+ * coalesced pairs allocates it once for its largest pair, see join_task.
+ */
+static inline size_t
+join_scratch_size(uint32_t numR)
+{
+    uint32_t N = numR;
+    NEXT_POW_2(N);
+    return (N + numR) * sizeof(int) + numR * sizeof(uint16_t)
+           + (get_hist_size(numR) + 2) * sizeof(int32_t);
+}
+
 /**
  * Histogram-based hash table build method together with relation re-ordering as
  * described by Kim et al. It joins partitions Ri, Si of relations R & S.
@@ -349,21 +608,24 @@ get_hist_size(uint32_t relSize)
  */
 static int64_t
 histogram_join(const relation_t * const R, const relation_t * const S,
-               relation_t * const tmpR, void * output, uint64_t * probe_cycles,
-               struct timeval * probe_time_total)
+               relation_t * const tmpR, int32_t radixbits, void * scratch,
+               void * output, uint64_t * probe_cycles,
+               struct timeval * probe_time_total, uint64_t * matchedS)
 {
     int32_t * restrict hist;
     const tuple_t * restrict const Rtuples = R->tuples;
     const uint32_t numR                    = R->num_tuples;
     uint32_t       Nhist                   = get_hist_size(numR);
-    const uint32_t MASK                    = (Nhist - 1) << NUM_RADIX_BITS;
+    const uint32_t MASK                    = (Nhist - 1) << radixbits;
     struct timeval probe_end, probe_start, probe;
 
-    hist = (int32_t *) calloc(Nhist + 2, sizeof(int32_t));
+    hist = scratch ? (int32_t *) scratch
+                   : (int32_t *) malloc((Nhist + 2) * sizeof(int32_t));
+    memset(hist, 0, (Nhist + 2) * sizeof(int32_t));
 
     for (uint32_t i = 0; i < numR; i++) {
 
-        uint32_t idx = HASH_BIT_MODULO(Rtuples[i].key, MASK, NUM_RADIX_BITS);
+        uint32_t idx = HASH_BIT_MODULO(Rtuples[i].key, MASK, radixbits);
 
         hist[idx + 2]++;
     }
@@ -378,7 +640,7 @@ histogram_join(const relation_t * const R, const relation_t * const S,
     /* reorder tuples according to the prefix sum */
     for (uint32_t i = 0; i < numR; i++) {
 
-        uint32_t idx = HASH_BIT_MODULO(Rtuples[i].key, MASK, NUM_RADIX_BITS) + 1;
+        uint32_t idx = HASH_BIT_MODULO(Rtuples[i].key, MASK, radixbits) + 1;
 
         tmpRtuples[hist[idx]] = Rtuples[i];
 
@@ -390,12 +652,14 @@ histogram_join(const relation_t * const R, const relation_t * const S,
     int64_t               match   = 0;
     const uint32_t        numS    = S->num_tuples;
     const tuple_t * const Stuples = S->tuples;
+    uint64_t              matched = 0;
     /* now comes the probe phase, TODO: implement prefetching */
     for (uint32_t i = 0; i < numS; i++) {
 
-        uint32_t idx = HASH_BIT_MODULO(Stuples[i].key, MASK, NUM_RADIX_BITS);
+        uint32_t idx = HASH_BIT_MODULO(Stuples[i].key, MASK, radixbits);
 
-        int j = hist[idx], end = hist[idx + 1];
+        int           j = hist[idx], end = hist[idx + 1];
+        const int64_t before = match;
 
         /* Scalar comparisons */
         for (; j < end; j++) {
@@ -406,14 +670,16 @@ histogram_join(const relation_t * const R, const relation_t * const S,
                 /* TODO: we do not output results */
             }
         }
+        matched += match != before;
     }
+    *matchedS += matched;
     stopTimer(probe_cycles);
     gettimeofday(&probe_end, NULL);
     timersub(&probe_end, &probe_start, &probe);
     timeradd(&probe, probe_time_total, probe_time_total);
 
     /* clean up */
-    free(hist);
+    if (!scratch) free(hist);
 
     return match;
 }
@@ -440,9 +706,11 @@ prefetch(void * addr)
  */
 static int64_t
 histogram_optimized_join(const relation_t * const R, const relation_t * const S,
-                         relation_t * const tmpR, void * output,
+                         relation_t * const tmpR, int32_t radixbits,
+                         void * scratch, void * output,
                          uint64_t *       probe_cycles,
-                         struct timeval * probe_time_total)
+                         struct timeval * probe_time_total,
+                         uint64_t *       matchedS)
 {
 #ifdef KEY_8B
 #warning SIMD comparison for 64-bit keys are not implemented!
@@ -452,14 +720,16 @@ histogram_optimized_join(const relation_t * const R, const relation_t * const S,
     const tuple_t * restrict const Rtuples = R->tuples;
     const uint32_t numR                    = R->num_tuples;
     uint32_t       Nhist                   = get_hist_size(numR);
-    const uint32_t mask                    = (Nhist - 1) << NUM_RADIX_BITS;
+    const uint32_t mask                    = (Nhist - 1) << radixbits;
     struct timeval probe_end, probe_start, probe;
 
-    hist = (int32_t *) calloc(Nhist + 2, sizeof(int32_t));
+    hist = scratch ? (int32_t *) scratch
+                   : (int32_t *) malloc((Nhist + 2) * sizeof(int32_t));
+    memset(hist, 0, (Nhist + 2) * sizeof(int32_t));
 
     /* compute histogram */
     for (uint32_t i = 0; i < numR; i++) {
-        uint32_t idx = HASH_BIT_MODULO(Rtuples[i].key, mask, NUM_RADIX_BITS);
+        uint32_t idx = HASH_BIT_MODULO(Rtuples[i].key, mask, radixbits);
         hist[idx + 2]++;
     }
 
@@ -472,7 +742,7 @@ histogram_optimized_join(const relation_t * const R, const relation_t * const S,
     tuple_t * restrict const tmpRtuples = tmpR->tuples;
     /* reorder tuples according to the prefix sum */
     for (uint32_t i = 0; i < numR; i++) {
-        uint32_t idx = HASH_BIT_MODULO(Rtuples[i].key, mask, NUM_RADIX_BITS) + 1;
+        uint32_t idx = HASH_BIT_MODULO(Rtuples[i].key, mask, radixbits) + 1;
         tmpRtuples[hist[idx]] = Rtuples[i];
         hist[idx]++;
     }
@@ -493,12 +763,15 @@ histogram_optimized_join(const relation_t * const R, const relation_t * const S,
     const uint32_t numS                    = S->num_tuples;
     const tuple_t * restrict const Stuples = S->tuples;
     __m128i counter                        = _mm_setzero_si128();
+    /* the lanes of the keys in a pair of tuples */
+    const __m128i key_lanes = _mm_set_epi32(0, -1, 0, -1);
+    uint64_t      matched   = 0;
 
     for (uint32_t i = 0; i < numS / PROBE_BUFFER_SIZE; i++) {
 
         for (int k = 0; k < PROBE_BUFFER_SIZE; k++) {
             const intkey_t skey = Stuples[i * PROBE_BUFFER_SIZE + k].key;
-            const uint32_t idx  = HASH_BIT_MODULO(skey, mask, NUM_RADIX_BITS);
+            const uint32_t idx  = HASH_BIT_MODULO(skey, mask, radixbits);
             /* now we issue a prefetch for element at S[idx] */
             prefetch(tmpR->tuples + hist[idx]);
             key_buffer[k]  = skey;
@@ -511,6 +784,7 @@ histogram_optimized_join(const relation_t * const R, const relation_t * const S,
             int     j          = hist[hash_buffer[k]];
             int     end        = hist[hash_buffer[k] + 1];
             __m128i search_key = _mm_set1_epi32(key_buffer[k]);
+            __m128i hits       = _mm_setzero_si128();
 
             for (; j < end; j += 2) {
 
@@ -518,37 +792,43 @@ histogram_optimized_join(const relation_t * const R, const relation_t * const S,
                     (__m128i const *) (tmpRtuples + j));
                 keyvals = _mm_cmpeq_epi32(keyvals, search_key);
                 counter = _mm_add_epi32(keyvals, counter);
+                hits    = _mm_or_si128(keyvals, hits);
                 /* TODO: we're just counting, not materializing results */
             }
+            matched += !_mm_testz_si128(hits, key_lanes);
         }
     }
 
     for (uint32_t i = numS - (numS % PROBE_BUFFER_SIZE); i < numS; i++) {
         const intkey_t skey = Stuples[i].key;
-        const uint32_t idx  = HASH_BIT_MODULO(skey, mask, NUM_RADIX_BITS);
+        const uint32_t idx  = HASH_BIT_MODULO(skey, mask, radixbits);
 
         /* SIMD comparisons in groups of 2 (8B x 2 = 128 bits) */
         int     j          = hist[idx];
         int     end        = hist[idx + 1];
         __m128i search_key = _mm_set1_epi32(skey);
+        __m128i hits       = _mm_setzero_si128();
 
         for (; j < end; j += 2) {
 
             __m128i keyvals = _mm_loadu_si128((__m128i const *) (tmpRtuples + j));
             keyvals         = _mm_cmpeq_epi32(keyvals, search_key);
             counter         = _mm_add_epi32(keyvals, counter);
+            hits            = _mm_or_si128(keyvals, hits);
             /* TODO: we're just counting, not outputting anything */
         }
+        matched += !_mm_testz_si128(hits, key_lanes);
     }
 
     match += -(_mm_extract_epi32(counter, 0) + _mm_extract_epi32(counter, 2));
+    *matchedS += matched;
     stopTimer(probe_cycles);
     gettimeofday(&probe_end, NULL);
     timersub(&probe_end, &probe_start, &probe);
     timeradd(&probe, probe_time_total, probe_time_total);
 
     /* clean up */
-    free(hist);
+    if (!scratch) free(hist);
 
     return match;
 #endif
@@ -568,11 +848,16 @@ histogram_optimized_join(const relation_t * const R, const relation_t * const S,
  * @param hist [out] number of tuples in each partition
  * @param R cluster bits
  * @param D radix bits per pass
+ * @param filter_strategy filter of the partition or NULL if not filtering
+ * @param filter_scan the scan matching filter_strategy
+ * @param usage INSERT the tuples into or CHECK them against the filter
  * @returns tuples per partition.
  */
 static void
 radix_cluster(relation_t * restrict outRel, relation_t * restrict inRel,
-              int32_t * restrict hist, int R, int D)
+              int32_t * restrict hist, int R, int D,
+              const bloom_filter_strategy_t * filter_strategy,
+              FilterScanFunction filter_scan, bloom_filter_usage_t usage)
 {
     uint32_t i;
     uint32_t M = ((1 << D) - 1) << R;
@@ -584,10 +869,22 @@ radix_cluster(relation_t * restrict outRel, relation_t * restrict inRel,
        just in case D differs from call to call. */
     uint32_t dst[fanOut];
 
-    /* count tuples per cluster */
-    for (i = 0; i < inRel->num_tuples; i++) {
-        uint32_t idx = HASH_BIT_MODULO(inRel->tuples[i].key, M, R);
-        hist[idx]++;
+    /* cache the results of contains computation for copy step */
+    uint64_t * selected = NULL;
+
+    if (filter_strategy) {
+        selected = (uint64_t *) malloc(BLOOM_SEL_WORDS(inRel->num_tuples)
+                                       * sizeof(uint64_t));
+        bloom_selection_fill(selected, inRel->num_tuples);
+        /* count tuples per cluster, the filter is checked batch-wise */
+        filter_scan(filter_strategy, inRel->tuples, inRel->num_tuples, usage,
+                    selected, NULL, NULL, hist, M, R);
+    } else {
+        /* count tuples per cluster */
+        for (i = 0; i < inRel->num_tuples; i++) {
+            uint32_t idx = HASH_BIT_MODULO(inRel->tuples[i].key, M, R);
+            hist[idx]++;
+        }
     }
     offset = 0;
     /* determine the start and end of each cluster depending on the counts. */
@@ -601,10 +898,174 @@ radix_cluster(relation_t * restrict outRel, relation_t * restrict inRel,
 
     /* copy tuples to their corresponding clusters at appropriate offsets */
     for (i = 0; i < inRel->num_tuples; i++) {
+        if (selected && usage == CHECK && !BLOOM_SELECTED(selected, i))
+            continue;
+
         uint32_t idx             = HASH_BIT_MODULO(inRel->tuples[i].key, M, R);
         outRel->tuples[dst[idx]] = inRel->tuples[i];
         ++dst[idx];
     }
+
+    free(selected);
+}
+
+/**
+ * Deselects the tuples of a batch whose key lies outside the key range of R in
+ * its partition, which covers the empty partitions of R too. The range table
+ * has one entry per partition and stays in L1.
+ *
+ * @param ranges the key range of each partition
+ * @param rel the tuples of the batch
+ * @param n the number of tuples
+ * @param sel [in/out] the selection bitmap of the batch
+ * @param MASK radix mask of the pass
+ * @param R radix shift of the pass
+ * @return the number of selected tuples that were deselected
+ */
+static inline uint32_t
+partition_prune(const partition_ranges_t * ranges, const tuple_t * rel,
+                uint32_t n, uint64_t * sel, uint32_t MASK, int32_t R)
+{
+    uint32_t pruned = 0;
+
+    for (uint32_t w = 0; w < BLOOM_SEL_WORDS(n); w++) {
+        const tuple_t * t    = rel + w * 64;
+        const uint32_t  nw   = MIN(64, n - w * 64);
+        uint64_t        keep = 0;
+        for (uint32_t i = 0; i < nw; i++) {
+            const intkey_t   key   = t[i].key;
+            const uint32_t   p     = HASH_BIT_MODULO(key, MASK, R);
+            const intkey_t * range = ranges->range[p];
+            keep |= (uint64_t) (key >= range[0] && key <= range[1]) << i;
+        }
+        pruned += __builtin_popcountll(sel[w] & ~keep);
+        sel[w] &= keep;
+    }
+    return pruned;
+}
+
+// clang-format off
+/**
+ * Body of a FilterScanFunction. ADD(filter, key) and
+ * CONTAINS_BATCH(filter, tuples, n, sel) are either the function pointers of
+ * the strategy or the inline specializations of bloom_filter_kernels.h. The
+ * first tier of the filter is always accessed through its function pointers,
+ * only the keys passing it are checked against the filter. The tuples of a
+ * checked batch that pass are compacted into dense while the batch is cached.
+ * Tuples pruned by the partition ranges count as failing the first tier.
+ */
+#define FILTER_SCAN_BODY(ADD, CONTAINS_BATCH)                           \
+    const bloom_filter_t *          filter = strategy->filter;          \
+    const bloom_filter_strategy_t * pre    = strategy->prefilter;       \
+    uint64_t passed = usage == CHECK && pre ? 0 : num_tuples;           \
+                                                                        \
+    for (uint32_t c = 0; c < num_tuples; c += BLOOM_BATCH_TUPLES) {     \
+        const uint32_t end = MIN(c + BLOOM_BATCH_TUPLES, num_tuples);   \
+                                                                        \
+        if (usage == CHECK && ranges) {                                 \
+            const uint32_t n = partition_prune(ranges, rel + c, end - c,\
+                                               selected + (c >> 6),     \
+                                               MASK, R);                \
+            ranges->pruned += n;                                        \
+            if (!pre) passed -= n;                                      \
+        }                                                               \
+        /* check the filter for a batch that stays cache resident */    \
+        if (usage == CHECK && pre)                                      \
+            passed += pre->contains_batch(pre->filter, rel + c, end - c,\
+                                          selected + (c >> 6));         \
+        if (usage == CHECK)                                             \
+            CONTAINS_BATCH(filter, rel + c, end - c, selected + (c >> 6));\
+        if (usage == CHECK && dense) {                                  \
+            const uint32_t n = bloom_selection_compact(                 \
+                rel + c, end - c, selected + (c >> 6), dense);          \
+            for (uint32_t i = 0; i < n; i++)                            \
+                hist[HASH_BIT_MODULO(dense[i].key, MASK, R)]++;         \
+            dense += n;                                                 \
+            continue;                                                   \
+        }                                                               \
+                                                                        \
+        for (uint32_t i = c; i < end; i++) {                            \
+            intkey_t key = rel[i].key;                                  \
+            if (usage == INSERT) {                                      \
+                ADD(filter, key);                                       \
+                if (pre) pre->add(pre->filter, key);                    \
+            } else if (usage == CHECK && !BLOOM_SELECTED(selected, i))  \
+                continue;                                               \
+                                                                        \
+            hist[HASH_BIT_MODULO(key, MASK, R)]++;                      \
+        }                                                               \
+    }                                                                   \
+    return passed;
+
+/** defines the scan specialized for VARIANT, B and K */
+#define DEFINE_FILTER_SCAN(VARIANT, B, K)                               \
+    BLOOM_SPECIALIZE(VARIANT, B, K)                                     \
+    static uint64_t                                                     \
+    filter_scan_##VARIANT##_##B##_##K(                                  \
+        const bloom_filter_strategy_t * strategy, const tuple_t * rel,  \
+        uint32_t num_tuples, bloom_filter_usage_t usage,                \
+        uint64_t * selected, tuple_t * dense,                           \
+        partition_ranges_t * ranges, int32_t * hist, uint32_t MASK,     \
+        int32_t R)                                                      \
+    {                                                                   \
+        FILTER_SCAN_BODY(bloom_add_##VARIANT##_##B##_##K,               \
+                         bloom_contains_batch_##VARIANT##_##B##_##K)    \
+    }
+
+#define FILTER_SCAN_ENTRY(VARIANT, B, K)                                \
+    { VARIANT, B, K, filter_scan_##VARIANT##_##B##_##K },
+// clang-format on
+
+BLOOM_KERNELS(DEFINE_FILTER_SCAN)
+
+/** specialized scans, see BLOOM_KERNELS for the covered parameters */
+static const struct {
+    bloom_filter_variant_t variant;
+    uint64_t               B;
+    uint64_t               k;
+    FilterScanFunction     scan;
+} filter_scans[] = {BLOOM_KERNELS(FILTER_SCAN_ENTRY)};
+
+/** fallback for filters without a specialization, dispatches per key */
+static uint64_t
+filter_scan_generic(const bloom_filter_strategy_t * strategy,
+                    const tuple_t * rel, uint32_t num_tuples,
+                    bloom_filter_usage_t usage, uint64_t * selected,
+                    tuple_t * dense, partition_ranges_t * ranges,
+                    int32_t * hist, uint32_t MASK, int32_t R)
+{
+    const bloom_filter_add_strategy_t            add = strategy->add;
+    const bloom_filter_contains_batch_strategy_t contains_batch =
+        strategy->contains_batch;
+
+    FILTER_SCAN_BODY(add, contains_batch)
+}
+
+/**
+ * Selects the scan for the parameters of a filter: the specialized kernel if
+ * there is one for its variant, B and k, and the generic scan otherwise.
+ *
+ * @param strategy the filter to select the scan for
+ * @return the selected scan
+ */
+static FilterScanFunction
+select_filter_scan(const bloom_filter_strategy_t * strategy)
+{
+    const bloom_filter_t * filter = strategy->filter;
+
+    for (size_t i = 0; i < sizeof(filter_scans) / sizeof(filter_scans[0]);
+         i++) {
+        if (filter_scans[i].variant == filter->variant
+            && filter_scans[i].k == filter->k
+            && (filter->variant == BASIC || filter_scans[i].B == filter->B)) {
+            DEBUGMSG(1, "Using specialized filter scan for k=%lu B=%lu\n",
+                     filter->k, filter->B);
+            return filter_scans[i].scan;
+        }
+    }
+    DEBUGMSG(1, "Using generic filter scan for k=%lu B=%lu\n", filter->k,
+             filter->B);
+    return filter_scan_generic;
 }
 
 /**
@@ -625,18 +1086,16 @@ radix_cluster_nopadding(relation_t * outRel, relation_t * inRel, int R, int D,
     tuple_t ** dst;
     tuple_t *  input;
     /* tuple_t ** dst_end; */
-    uint32_t *     tuples_per_cluster;
+    int32_t *      tuples_per_cluster;
     uint32_t       i;
     uint32_t       offset;
     const uint32_t M       = ((1 << D) - 1) << R;
     const uint32_t fanOut  = 1 << D;
     const uint32_t ntuples = inRel->num_tuples;
 
-    const bloom_filter_contains_strategy_t contains = filter_strategy->contains;
-    const bloom_filter_add_strategy_t      add      = filter_strategy->add;
-    const bloom_filter_t *                 filter   = filter_strategy->filter;
+    const FilterScanFunction filter_scan = select_filter_scan(filter_strategy);
 
-    tuples_per_cluster = (uint32_t *) calloc(fanOut, sizeof(uint32_t));
+    tuples_per_cluster = (int32_t *) calloc(fanOut, sizeof(int32_t));
     /* the following are fixed size when D is same for all the passes,
        and can be re-used from call to call. Allocating in this function
        just in case D differs from call to call. */
@@ -644,22 +1103,14 @@ radix_cluster_nopadding(relation_t * outRel, relation_t * inRel, int R, int D,
     /* dst_end = (tuple_t**)malloc(sizeof(tuple_t*)*fanOut); */
 
     /* cache the results of contains computation for copy step */
-    char * contains_cache = (char *) calloc((ntuples + 7) / 8, 1);
+    uint64_t * selected = (uint64_t *) malloc(BLOOM_SEL_WORDS(ntuples)
+                                              * sizeof(uint64_t));
+    bloom_selection_fill(selected, ntuples);
 
     input = inRel->tuples;
-    /* count tuples per cluster */
-    for (i = 0; i < ntuples; i++) {
-        intkey_t key = input[i].key;
-        if (usage == INSERT)
-            add(filter, key);
-        else if (usage == CHECK && !contains(filter, key))
-            continue;
-        else if (usage == CHECK)
-            contains_cache[i >> 3] |= 1 << (i & 7);
-
-        uint32_t idx = (uint32_t) (HASH_BIT_MODULO(key, M, R));
-        tuples_per_cluster[idx]++;
-    }
+    /* count tuples per cluster, the filter is checked batch-wise */
+    filter_scan(filter_strategy, input, ntuples, usage, selected, NULL, NULL,
+                tuples_per_cluster, M, R);
 
     offset = 0;
     /* determine the start and end of each cluster depending on the counts. */
@@ -673,8 +1124,7 @@ radix_cluster_nopadding(relation_t * outRel, relation_t * inRel, int R, int D,
     input = inRel->tuples;
     /* copy tuples to their corresponding clusters at appropriate offsets */
     for (i = 0; i < ntuples; i++) {
-        if (usage == CHECK && !(contains_cache[i >> 3] & (1 << (i & 7))))
-            continue;
+        if (usage == CHECK && !BLOOM_SELECTED(selected, i)) continue;
 
         uint32_t idx = (uint32_t) (HASH_BIT_MODULO(input[i].key, M, R));
         *dst[idx]    = *(input + i);
@@ -686,7 +1136,7 @@ radix_cluster_nopadding(relation_t * outRel, relation_t * inRel, int R, int D,
     }
 
     /* clean up temp */
-    free(contains_cache);
+    free(selected);
     /* free(dst_end); */
     free(dst);
     free(tuples_per_cluster);
@@ -696,31 +1146,135 @@ radix_cluster_nopadding(relation_t * outRel, relation_t * inRel, int R, int D,
  * This function implements the radix clustering of a given input
  * relations. The relations to be clustered are defined in task_t and after
  * clustering, each partition pair is added to the join_queue to be joined.
+ * With a partition-local filter, the tuples of R are inserted into it while R
+ * is clustered and the tuples of S are checked against it while S is
+ * clustered, so the filter stays cache resident. With a semi-join filter
+ * built from S in pass-1, the tuples of R without a partner in S are dropped
+ * while R is clustered, before hash tables are built for them.
+ *
+ * Partition pairs with fewer than COALESCE_TASK_TUPLES tuples, which are most
+ * of them after a selective filter, are coalesced into one join task: the
+ * task records where the clusters of each pair are, so the pairs go through
+ * the join queue once and share one hash table allocation, see join_task.
+ *
+ * With D = 0 and no filter to apply, the partitions of the task are joined as
+ * they are: the pair is queued without copying it.
  *
  * @param task description of the relation to be partitioned
  * @param join_queue task queue to add join tasks after clustering
+ * @param filter_strategy empty filter for the partition or NULL
+ * @param filter_scan the scan matching filter_strategy
+ * @param semi_strategy filter of S that R is checked against or NULL
+ * @param semi_scan the scan matching semi_strategy
+ * @param removedR [out] number of R-tuples dropped by semi_strategy
+ * @param joinpairs [out] incremented by the partition pairs to be joined
+ * @param jointasks [out] incremented by the join tasks they were queued in
+ * @return the number of S-tuples after clustering (and filtering)
  */
-static void
+static uint64_t
 serial_radix_partition(task_t * const task, task_queue_t * join_queue,
-                       const int R, const int D)
+                       const int R, const int D,
+                       bloom_filter_strategy_t *       filter_strategy,
+                       FilterScanFunction              filter_scan,
+                       const bloom_filter_strategy_t * semi_strategy,
+                       FilterScanFunction semi_scan, uint64_t * removedR,
+                       uint64_t * joinpairs, uint64_t * jointasks)
 {
-    int       i;
-    uint32_t  offsetR = 0, offsetS = 0;
-    const int fanOut = 1 << D; /*(NUM_RADIX_BITS / NUM_PASSES);*/
-    int32_t * outputR, *outputS;
+    int                  i;
+    uint32_t             offsetR = 0, offsetS = 0;
+    const int            fanOut = 1 << D; /*(NUM_RADIX_BITS / NUM_PASSES);*/
+    int32_t *            outputR, *outputS;
+    bloom_filter_usage_t usageR = INSERT;
+
+    if (D == 0 && !filter_strategy && !semi_strategy) {
+        if (task->relR.num_tuples > 0 && task->relS.num_tuples > 0) {
+            task_t * t   = task_queue_get_slot_atomic(join_queue);
+            t->relR      = task->relR;
+            t->tmpR      = task->tmpR;
+            t->relS      = task->relS;
+            t->tmpS      = task->tmpS;
+            t->radixbits = R;
+            task_queue_add_atomic(join_queue, t);
+            (*joinpairs)++;
+            (*jointasks)++;
+        }
+        return task->relS.num_tuples;
+    }
+
+    /* a static filter is built from the whole partition of R at once */
+    if (filter_strategy && bloom_filter_is_static(filter_strategy)) {
+        bloom_filter_build(filter_strategy, task->relR.tuples,
+                           task->relR.num_tuples);
+        usageR = IGNORE;
+    }
 
     outputR = (int32_t *) calloc(fanOut + 1, sizeof(int32_t));
     outputS = (int32_t *) calloc(fanOut + 1, sizeof(int32_t));
     /* TODO: measure the effect of memset() */
     /* memset(outputR, 0, fanOut * sizeof(int32_t)); */
-    radix_cluster(&task->tmpR, &task->relR, outputR, R, D);
+    if (semi_strategy) {
+        radix_cluster(&task->tmpR, &task->relR, outputR, R, D, semi_strategy,
+                      semi_scan, CHECK);
+    } else {
+        radix_cluster(&task->tmpR, &task->relR, outputR, R, D,
+                      filter_strategy, filter_scan, usageR);
+    }
 
     /* memset(outputS, 0, fanOut * sizeof(int32_t)); */
-    radix_cluster(&task->tmpS, &task->relS, outputS, R, D);
+    radix_cluster(&task->tmpS, &task->relS, outputS, R, D, filter_strategy,
+                  filter_scan, CHECK);
+
+    /* the task small partition pairs are coalesced into, or NULL */
+    task_t * group = NULL;
 
-    /* task_t t; */
     for (i = 0; i < fanOut; i++) {
+        const uint32_t ntuples = outputR[i] + outputS[i];
+
         if (outputR[i] > 0 && outputS[i] > 0) {
+            (*joinpairs)++;
+        }
+        if (outputR[i] > 0 && outputS[i] > 0
+            && ntuples < COALESCE_TASK_TUPLES) {
+            if (group
+                && group->relR.num_tuples + group->relS.num_tuples + ntuples
+                       > COALESCE_TASK_TUPLES) {
+                task_queue_add_atomic(join_queue, group);
+                (*jointasks)++;
+                group = NULL;
+            }
+            tuple_t * clusterR = task->tmpR.tuples + offsetR
+                                 + i * SMALL_PADDING_TUPLES;
+            tuple_t * clusterS = task->tmpS.tuples + offsetS
+                                 + i * SMALL_PADDING_TUPLES;
+            if (!group) {
+                group = task_queue_get_slot_atomic(join_queue);
+                group->relR.tuples     = clusterR;
+                group->tmpR.tuples     = task->relR.tuples + offsetR
+                                     + i * SMALL_PADDING_TUPLES;
+                group->relS.tuples     = clusterS;
+                group->tmpS.tuples     = task->relS.tuples + offsetS
+                                     + i * SMALL_PADDING_TUPLES;
+                group->relR.num_tuples = 0;
+                group->relS.num_tuples = 0;
+                group->radixbits       = R + D;
+                /* every pair has at least two tuples */
+                group->pairs  = (task_pair_t *) malloc(
+                    MIN(fanOut - i, COALESCE_TASK_TUPLES / 2)
+                    * sizeof(task_pair_t));
+                group->npairs = 0;
+            }
+            /* the clusters stay where they are, the task keeps their
+               offsets from its first one */
+            task_pair_t * pair = &group->pairs[group->npairs++];
+            pair->offR         = clusterR - group->relR.tuples;
+            pair->numR         = outputR[i];
+            pair->offS         = clusterS - group->relS.tuples;
+            pair->numS         = outputS[i];
+            group->relR.num_tuples += outputR[i];
+            group->relS.num_tuples += outputS[i];
+            offsetR += outputR[i];
+            offsetS += outputS[i];
+        } else if (outputR[i] > 0 && outputS[i] > 0) {
             task_t * t         = task_queue_get_slot_atomic(join_queue);
             t->relR.num_tuples = outputR[i];
             t->relR.tuples     = task->tmpR.tuples + offsetR
@@ -735,16 +1289,160 @@ serial_radix_partition(task_t * const task, task_queue_t * join_queue,
             t->tmpS.tuples = task->relS.tuples + offsetS
                              + i * SMALL_PADDING_TUPLES;
             offsetS += outputS[i];
+            t->radixbits = R + D;
 
             /* task_queue_copy_atomic(join_queue, &t); */
             task_queue_add_atomic(join_queue, t);
+            (*jointasks)++;
         } else {
             offsetR += outputR[i];
             offsetS += outputS[i];
         }
     }
+    if (group) {
+        task_queue_add_atomic(join_queue, group);
+        (*jointasks)++;
+    }
     free(outputR);
     free(outputS);
+
+    *removedR += task->relR.num_tuples - offsetR;
+    return offsetS;
+}
+
+/**
+ * Checks tuples against the global filter and counts how many of them pass
+ * its first tier and both tiers. With partition pruning, the tuples outside
+ * the key ranges of R are dropped first and not counted as checked.
+ *
+ * @return the number of tuples that passed the filter
+ */
+static uint64_t
+check_filter_scan(arg_t * const args, const bloom_filter_strategy_t * strategy,
+                  const tuple_t * rel, uint32_t num_tuples, uint64_t * selected,
+                  tuple_t * dense, int32_t * hist, uint32_t MASK, int32_t R)
+{
+    partition_ranges_t * ranges =
+        args->part_ranges.range ? &args->part_ranges : NULL;
+    const uint64_t pruned = args->part_ranges.pruned;
+    uint64_t       passed = 0;
+
+#ifndef NO_TIMING
+    resumeTimer(&args->filter_check_timer);
+#endif
+    args->prefilter_passed += args->filter_scan(strategy, rel, num_tuples,
+                                                CHECK, selected, dense, ranges,
+                                                hist, MASK, R);
+#ifndef NO_TIMING
+    stopTimer(&args->filter_check_timer);
+#endif
+    for (uint32_t w = 0; w < BLOOM_SEL_WORDS(num_tuples); w++) {
+        passed += __builtin_popcountll(selected[w]);
+    }
+    args->checked += num_tuples - (args->part_ranges.pruned - pruned);
+    args->filter_passed += passed;
+    return passed;
+}
+
+/**
+ * Runs the filter scan of a parallel partitioning pass. With an adaptive
+ * bypass, S is checked against the filter for the first
+ * BLOOM_BYPASS_SAMPLE_TUPLES tuples of the thread only. If more of them pass
+ * than the threshold, the filter is ignored for the rest of the range since it
+ * would hardly drop any tuples.
+ *
+ * @param part description of the relation to be partitioned
+ * @param strategy the filter to insert into or check against
+ * @param selected [in/out] selection bitmap of the tuples
+ * @param dense [out] the tuples passing the filter, see partition_dense_buffer
+ * @param hist the histogram to count the tuples in
+ * @param MASK radix mask of the pass
+ * @param R radix shift of the pass
+ * @return the number of tuples in dense
+ */
+static uint32_t
+partition_filter_scan(part_t * const part,
+                      const bloom_filter_strategy_t * strategy,
+                      uint64_t * selected, tuple_t * dense, int32_t * hist,
+                      uint32_t MASK, int32_t R)
+{
+    arg_t * const            args        = part->thrargs;
+    const FilterScanFunction filter_scan = args->filter_scan;
+    const uint32_t           num_tuples  = part->num_tuples;
+
+    /* the key range of R for an exact filter is found in the histogram scan */
+    if (part->relidx == 0 && args->key_ranges) {
+        intkey_t min = num_tuples ? part->rel[0].key : 1;
+        intkey_t max = num_tuples ? part->rel[0].key : 0;
+        for (uint32_t i = 0; i < num_tuples; i++) {
+            const intkey_t key = part->rel[i].key;
+            min                = MIN(min, key);
+            max                = MAX(max, key);
+            hist[HASH_BIT_MODULO(key, MASK, R)]++;
+        }
+        args->key_ranges[args->my_tid][0] = min;
+        args->key_ranges[args->my_tid][1] = max;
+        return 0;
+    }
+    if (part->usage == INSERT) {
+#ifndef NO_TIMING
+        resumeTimer(&args->filter_add_timer);
+#endif
+        filter_scan(strategy, part->rel, num_tuples, INSERT, selected, NULL,
+                    NULL, hist, MASK, R);
+#ifndef NO_TIMING
+        stopTimer(&args->filter_add_timer);
+#endif
+        return 0;
+    }
+    if (part->usage != CHECK) {
+        filter_scan(strategy, part->rel, num_tuples, part->usage, selected,
+                    NULL, NULL, hist, MASK, R);
+        return 0;
+    }
+    if (args->bypass_threshold >= 1.0) {
+        return check_filter_scan(args, strategy, part->rel, num_tuples,
+                                 selected, dense, hist, MASK, R);
+    }
+
+    const uint32_t nsample = MIN(BLOOM_BYPASS_SAMPLE_TUPLES, num_tuples);
+    const uint64_t passed  = check_filter_scan(args, strategy, part->rel,
+                                               nsample, selected, NULL, hist,
+                                               MASK, R);
+
+    args->sampled_pass_rate = nsample ? passed / (double) nsample : 0;
+    args->bypassed          = args->sampled_pass_rate > args->bypass_threshold;
+
+    /* the rest stays selected if the filter is bypassed */
+    if (args->bypassed) {
+        filter_scan(strategy, part->rel + nsample, num_tuples - nsample,
+                    IGNORE, selected + nsample / 64, NULL, NULL, hist, MASK,
+                    R);
+    } else {
+        check_filter_scan(args, strategy, part->rel + nsample,
+                          num_tuples - nsample, selected + nsample / 64, NULL,
+                          hist, MASK, R);
+    }
+    return 0;
+}
+
+/**
+ * Allocates the buffer that the S-tuples passing the global filter are
+ * compacted into during the filter scan of pass-1, so the scatter reads only
+ * them instead of all of rel and the selection bitmap. Pages are only touched
+ * for the tuples that pass. With an adaptive bypass the filter may be ignored
+ * for most of rel, which is scattered from rel then.
+ *
+ * @param part description of the relation to be partitioned
+ * @return the buffer, NULL if the tuples are scattered from rel
+ */
+static tuple_t *
+partition_dense_buffer(const part_t * part)
+{
+    if (part->usage != CHECK || part->thrargs->bypass_threshold < 1.0)
+        return NULL;
+    return (tuple_t *) alloc_aligned((part->num_tuples + BLOOM_COMPACT_PADDING)
+                                     * sizeof(tuple_t));
 }
 
 /**
@@ -771,12 +1469,15 @@ parallel_radix_partition(part_t * const part)
     const uint32_t fanOut  = 1 << D;
     const uint32_t MASK    = (fanOut - 1) << R;
     const uint32_t padding = part->padding;
-    const bool     build   = part->relidx == 0;
+    const bloom_filter_usage_t usage = part->usage;
+    /* S-tuples that pass are inserted into the semi-join filter of R */
+    const bloom_filter_strategy_t * semi =
+        part->relidx == 1 ? part->thrargs->semi_filter_strategy : NULL;
+    intkey_t(*ranges)[2] = part->ranges;
 
-    const bloom_filter_strategy_t * strategy = part->thrargs->bloom_filter_strategy;
-    const bloom_filter_contains_strategy_t contains = strategy->contains;
-    const bloom_filter_add_strategy_t      add      = strategy->add;
-    const bloom_filter_t *                 filter   = strategy->filter;
+    const bloom_filter_strategy_t * strategy =
+        usage == INSERT ? part->thrargs->build_filter_strategy
+                        : part->thrargs->bloom_filter_strategy;
 
     int64_t  sum = 0;
     uint32_t i, j;
@@ -785,24 +1486,17 @@ parallel_radix_partition(part_t * const part)
     int64_t dst[fanOut + 1];
 
     /* cache the results of contains computation for copy step */
-    char * contains_cache = (char *) calloc((num_tuples + 7) / 8, 1);
+    uint64_t * selected = (uint64_t *) malloc(BLOOM_SEL_WORDS(num_tuples)
+                                              * sizeof(uint64_t));
+    bloom_selection_fill(selected, num_tuples);
 
     /* compute local histogram for the assigned region of rel */
     /* compute histogram */
     int32_t * my_hist = hist[my_tid];
 
-    for (i = 0; i < num_tuples; i++) {
-        intkey_t key = rel[i].key;
-        if (build)
-            add(filter, key);
-        else if (!contains(filter, key))
-            continue;
-        else
-            contains_cache[i >> 3] |= 1 << (i & 7);
-
-        uint32_t idx = HASH_BIT_MODULO(key, MASK, R);
-        my_hist[idx]++;
-    }
+    tuple_t * dense  = partition_dense_buffer(part);
+    uint32_t  ndense = partition_filter_scan(part, strategy, selected, dense,
+                                             my_hist, MASK, R);
 
     /* compute local prefix sum on hist */
     for (i = 0; i < fanOut; i++) {
@@ -838,17 +1532,28 @@ parallel_radix_partition(part_t * const part)
 
     tuple_t * restrict tmp = part->tmp;
 
+    /* the tuples passing the filter are scattered from dense, if compacted */
+    const tuple_t * restrict src  = dense ? dense : rel;
+    const uint32_t           nsrc = dense ? ndense : num_tuples;
+    const bool               skip = usage == CHECK && !dense;
+
     /* Copy tuples to their corresponding clusters */
-    for (i = 0; i < num_tuples; i++) {
-        if (!build && !(contains_cache[i >> 3] & (1 << (i & 7)))) continue;
+    for (i = 0; i < nsrc; i++) {
+        if (skip && !BLOOM_SELECTED(selected, i)) continue;
+        if (semi) semi->add(semi->filter, src[i].key);
 
-        tuple_t  t    = rel[i];
+        tuple_t  t    = src[i];
         uint32_t idx  = HASH_BIT_MODULO(t.key, MASK, R);
         tmp[dst[idx]] = t;
         ++dst[idx];
+        if (ranges) {
+            ranges[idx][0] = MIN(ranges[idx][0], t.key);
+            ranges[idx][1] = MAX(ranges[idx][1], t.key);
+        }
     }
 
-    free(contains_cache);
+    free(dense);
+    free(selected);
 }
 
 /**
@@ -939,36 +1644,32 @@ parallel_radix_partition_optimized(part_t * const part)
     const uint32_t fanOut  = 1 << D;
     const uint32_t MASK    = (fanOut - 1) << R;
     const uint32_t padding = part->padding;
-    const bool     build   = part->relidx == 0;
+    const bloom_filter_usage_t usage = part->usage;
+    /* S-tuples that pass are inserted into the semi-join filter of R */
+    const bloom_filter_strategy_t * semi =
+        part->relidx == 1 ? part->thrargs->semi_filter_strategy : NULL;
+    intkey_t(*ranges)[2] = part->ranges;
 
-    const bloom_filter_strategy_t * strategy = part->thrargs->bloom_filter_strategy;
-    const bloom_filter_contains_strategy_t contains = strategy->contains;
-    const bloom_filter_add_strategy_t      add      = strategy->add;
-    const bloom_filter_t *                 filter   = strategy->filter;
+    const bloom_filter_strategy_t * strategy =
+        usage == INSERT ? part->thrargs->build_filter_strategy
+                        : part->thrargs->bloom_filter_strategy;
 
     int64_t  sum = 0;
     uint32_t i, j;
     int      rv;
 
     /* cache the results of contains computation for copy step */
-    char * contains_cache = (char *) calloc((num_tuples + 7) / 8, 1);
+    uint64_t * selected = (uint64_t *) malloc(BLOOM_SEL_WORDS(num_tuples)
+                                              * sizeof(uint64_t));
+    bloom_selection_fill(selected, num_tuples);
 
     /* compute local histogram for the assigned region of rel */
     /* compute histogram */
     int32_t * my_hist = hist[my_tid];
 
-    for (i = 0; i < num_tuples; i++) {
-        intkey_t key = rel[i].key;
-        if (build)
-            add(filter, key);
-        else if (!contains(filter, key))
-            continue;
-        else
-            contains_cache[i >> 3] |= 1 << (i & 7);
-
-        uint32_t idx = HASH_BIT_MODULO(key, MASK, R);
-        my_hist[idx]++;
-    }
+    tuple_t * dense  = partition_dense_buffer(part);
+    uint32_t  ndense = partition_filter_scan(part, strategy, selected, dense,
+                                             my_hist, MASK, R);
     /* compute local prefix sum on hist */
     for (i = 0; i < fanOut; i++) {
         sum += my_hist[i];
@@ -1009,16 +1710,26 @@ parallel_radix_partition_optimized(part_t * const part)
     }
     output[fanOut] += fanOut * padding;
 
+    /* the tuples passing the filter are scattered from dense, if compacted */
+    const tuple_t * restrict src  = dense ? dense : rel;
+    const uint32_t           nsrc = dense ? ndense : num_tuples;
+    const bool               skip = usage == CHECK && !dense;
+
     /* Copy tuples to their corresponding clusters */
 
-    for (i = 0; i < num_tuples; i++) {
-        if (!build && !(contains_cache[i >> 3] & (1 << (i & 7)))) continue;
+    for (i = 0; i < nsrc; i++) {
+        if (skip && !BLOOM_SELECTED(selected, i)) continue;
+        if (semi) semi->add(semi->filter, src[i].key);
 
-        uint32_t  idx     = HASH_BIT_MODULO(rel[i].key, MASK, R);
+        uint32_t  idx     = HASH_BIT_MODULO(src[i].key, MASK, R);
         uint64_t  slot    = buffer[idx].data.slot;
+        if (ranges) {
+            ranges[idx][0] = MIN(ranges[idx][0], src[i].key);
+            ranges[idx][1] = MAX(ranges[idx][1], src[i].key);
+        }
         tuple_t * tup     = (tuple_t *) (buffer + idx);
         uint32_t  slotMod = (slot) & (TUPLESPERCACHELINE - 1);
-        tup[slotMod]      = rel[i];
+        tup[slotMod]      = src[i];
 
         if (slotMod == (TUPLESPERCACHELINE - 1)) {
             /* write out 64-Bytes with non-temporal store */
@@ -1042,11 +1753,118 @@ parallel_radix_partition_optimized(part_t * const part)
         }
     }
 
-    free(contains_cache);
+    free(dense);
+    free(selected);
 }
 
 /** @} */
 
+/**
+ * Splits the bitmap of a filter into cache-line aligned byte ranges, one per
+ * thread, so threads can clear, merge or count the filter in parallel.
+ *
+ * @param filter the filter to be split
+ * @param tid the thread whose range is computed
+ * @param nthreads number of threads
+ * @param from [out] first byte of the range
+ * @param to [out] end of the range (exclusive)
+ */
+static void
+filter_share(const bloom_filter_t * filter, int tid, int nthreads,
+             uint64_t * from, uint64_t * to)
+{
+    const uint64_t nbytes = filter->m / 8;
+    const uint64_t chunk  = ((nbytes + nthreads - 1) / nthreads
+                            + CACHE_LINE_SIZE - 1)
+                           & ~(uint64_t) (CACHE_LINE_SIZE - 1);
+
+    *from = MIN(tid * chunk, nbytes);
+    *to   = MIN(*from + chunk, nbytes);
+}
+
+/**
+ * Clears the share of a thread of a filter created with lazy_clear. The first
+ * touch of the thread places the pages of its share on its NUMA node.
+ */
+static void
+filter_clear_share(bloom_filter_strategy_t * strategy, int tid, int nthreads)
+{
+    uint64_t from, to;
+
+    /* an exact filter is only allocated once the key range of R is known */
+    if (!strategy->filter->lazy_clear || !strategy->filter->bitmap) return;
+
+    filter_share(strategy->filter, tid, nthreads, &from, &to);
+    bloom_filter_reset_range(strategy, from, to);
+}
+
+/**
+ * Picks the radix bits of pass-2 for a pass-1 partition: the fewest bits that
+ * split its R-tuples into partitions of at most target tuples, so their hash
+ * tables fit L2 while S is only streamed through. 0 skips pass-2 for the
+ * partition, at most PASS2_MAX_RADIXBITS bits are used.
+ *
+ * @param ntupR R-tuples of the pass-1 partition
+ * @param target R-tuples per pass-2 partition
+ * @return the radix bits of pass-2
+ */
+static inline int
+pass2_radixbits(uint32_t ntupR, uint64_t target)
+{
+    int bits = 0;
+    while (bits < PASS2_MAX_RADIXBITS && (ntupR >> bits) > target)
+        bits++;
+    return bits;
+}
+
+/**
+ * Joins a task from the join queue. A task of coalesced partition pairs, see
+ * serial_radix_partition, joins each of its pairs on its own: the hash tables
+ * of the joins index the key bits above the radix bits of the task, so one
+ * table for all pairs would chain their keys together. The pairs share one
+ * allocation for their hash tables, sized for the largest of them.
+ *
+ * @param args arguments of the thread
+ * @param task the join task
+ * @param output join results, if JOIN_RESULT_MATERIALIZE defined.
+ * @return number of result tuples
+ */
+static int64_t
+join_task(arg_t * const args, task_t * const task, void * output)
+{
+    const JoinFunction join = args->join_function;
+
+    if (!task->pairs) {
+        return join(&task->relR, &task->relS, &task->tmpR, task->radixbits,
+                    NULL, output, &args->timer2, &args->probe,
+                    &args->matchedS);
+    }
+
+    uint32_t maxR = 0;
+    for (int p = 0; p < task->npairs; p++) {
+        maxR = MAX(maxR, task->pairs[p].numR);
+    }
+    void *  scratch = malloc(join_scratch_size(maxR));
+    int64_t results = 0;
+
+    for (int p = 0; p < task->npairs; p++) {
+        const task_pair_t * pair = &task->pairs[p];
+
+        relation_t pairR    = {.tuples     = task->relR.tuples + pair->offR,
+                               .num_tuples = pair->numR};
+        relation_t pairS    = {.tuples     = task->relS.tuples + pair->offS,
+                               .num_tuples = pair->numS};
+        relation_t pairTmpR = {.tuples     = task->tmpR.tuples + pair->offR,
+                               .num_tuples = pair->numR};
+        results += join(&pairR, &pairS, &pairTmpR, task->radixbits, scratch,
+                        output, &args->timer2, &args->probe, &args->matchedS);
+    }
+    free(scratch);
+    free(task->pairs);
+
+    return results;
+}
+
 /**
  * The main thread of parallel radix join. It does partitioning in parallel with
  * other threads and during the join phase, picks up join tasks from the task
@@ -1064,8 +1882,11 @@ prj_thread(void * param)
 
     const int fanOut = 1 << (NUM_RADIX_BITS / NUM_PASSES);  // PASS1RADIXBITS;
     const int R      = (NUM_RADIX_BITS / NUM_PASSES);       // PASS1RADIXBITS;
-    const int D      = (NUM_RADIX_BITS
+#ifdef SKEW_HANDLING
+    /* the skewed partitions are split by the fixed pass-2 fanout */
+    const int D = (NUM_RADIX_BITS
                    - (NUM_RADIX_BITS / NUM_PASSES));  // PASS2RADIXBITS;
+#endif
 
     uint64_t results = 0;
     int      i;
@@ -1094,6 +1915,47 @@ prj_thread(void * param)
     args->histR[my_tid] = (int32_t *) calloc(fanOut, sizeof(int32_t));
     args->histS[my_tid] = (int32_t *) calloc(fanOut, sizeof(int32_t));
 
+    /* thread-local filter, allocated by the thread itself to be numa-local */
+    args->build_filter_strategy = args->bloom_filter_strategy;
+    if (args->local_filter_strategies) {
+        args->build_filter_strategy =
+            bloom_filter_create_like(args->bloom_filter_strategy);
+        args->local_filter_strategies[my_tid] = args->build_filter_strategy;
+    }
+
+    /* filter of the pass-2 partitions, reused for each partition */
+    args->partition_filter_strategy = NULL;
+    args->filtered                  = 0;
+    args->sampled_pass_rate         = 0;
+    args->removedR                  = 0;
+    args->joinpairs                 = 0;
+    args->jointasks                 = 0;
+    memset(args->pass2_fanouts, 0, sizeof(args->pass2_fanouts));
+    args->checked                   = 0;
+    args->prefilter_passed          = 0;
+    args->filter_passed             = 0;
+    args->matchedS                  = 0;
+    args->filter_bits               = 0;
+    args->bypassed                  = false;
+    if (args->filter_placement == PASS2_LOCAL) {
+        args->partition_filter_strategy =
+            bloom_filter_create_like(args->bloom_filter_strategy);
+    }
+
+    /* key ranges of the R partitions of this thread, merged after pass-1 */
+    intkey_t(*my_part_ranges)[2] = NULL;
+    args->part_ranges.range      = NULL;
+    args->part_ranges.pruned     = 0;
+    if (args->thread_part_ranges) {
+        my_part_ranges = args->thread_part_ranges + my_tid * fanOut;
+        for (i = 0; i < fanOut; i++) {
+            my_part_ranges[i][0] = INTKEY_MAX;
+            my_part_ranges[i][1] = INTKEY_MIN;
+        }
+        args->part_ranges.range = malloc(fanOut * sizeof(*my_part_ranges));
+        MALLOC_CHECK(args->part_ranges.range);
+    }
+
     /* in the first pass, partitioning is done together by all threads */
 
     args->parts_processed = 0;
@@ -1103,6 +1965,13 @@ prj_thread(void * param)
     perf_counter_manager_init(&args->perf_counter_manager);
 #endif
 
+    /* the global filters are cleared in parallel instead of by the main
+       thread, the pages of each share are then local to the clearing thread */
+    filter_clear_share(args->bloom_filter_strategy, my_tid, args->nthreads);
+    if (args->semi_filter_strategy) {
+        filter_clear_share(args->semi_filter_strategy, my_tid, args->nthreads);
+    }
+
     /* wait at a barrier until each thread starts and then start the timer */
     BARRIER_ARRIVE(args->barrier, rv);
 
@@ -1125,8 +1994,13 @@ prj_thread(void * param)
         gettimeofday(&args->start, NULL);
         startTimer(&args->timer1);
         startTimer(&args->timer3);
+        startTimer(&args->filter_build_timer);
+        resetTimer(&args->filter_merge_timer);
+        resetTimer(&args->filter_replicate_timer);
     }
     resetTimer(&args->timer2);
+    resetTimer(&args->filter_add_timer);
+    resetTimer(&args->filter_check_timer);
     timerclear(&args->probe);
 #endif
 
@@ -1134,7 +2008,8 @@ prj_thread(void * param)
     part.R       = 0;
     part.D       = NUM_RADIX_BITS / NUM_PASSES;  // PASS1RADIXBITS
     part.thrargs = args;
-    part.padding = PADDING_TUPLES;
+    part.padding = args->pass2_target ? PASS2_MAX_PADDING_TUPLES
+                                      : PADDING_TUPLES;
 
     /* 1. partitioning for relation R */
     part.rel          = args->relR;
@@ -1144,6 +2019,11 @@ prj_thread(void * param)
     part.num_tuples   = args->numR;
     part.total_tuples = args->totalR;
     part.relidx       = 0;
+    part.usage = args->partition_filter_strategy || args->filter_loaded
+                         || bloom_filter_is_static(args->bloom_filter_strategy)
+                     ? IGNORE
+                     : INSERT;
+    part.ranges = my_part_ranges;
 
 #ifdef USE_SWWC_OPTIMIZED_PART
     parallel_radix_partition_optimized(&part);
@@ -1152,6 +2032,130 @@ prj_thread(void * param)
 #endif
     BARRIER_ARRIVE(args->barrier, rv);
 
+    /* each thread merges the key ranges of all threads into its own table,
+       which stays in L1 while S is pruned by it */
+    if (args->part_ranges.range) {
+        intkey_t(*range)[2] = args->part_ranges.range;
+        for (i = 0; i < fanOut; i++) {
+            range[i][0] = INTKEY_MAX;
+            range[i][1] = INTKEY_MIN;
+        }
+        for (int t = 0; t < args->nthreads; t++) {
+            intkey_t(*other)[2] = args->thread_part_ranges + t * fanOut;
+            for (i = 0; i < fanOut; i++) {
+                range[i][0] = MIN(range[i][0], other[i][0]);
+                range[i][1] = MAX(range[i][1], other[i][1]);
+            }
+        }
+    }
+
+    /* merge the thread-local filters, each thread ORs a disjoint range */
+    if (args->local_filter_strategies) {
+#ifndef NO_TIMING
+        if (my_tid == 0) startTimer(&args->filter_merge_timer);
+#endif
+        uint64_t from, to;
+
+        filter_share(args->bloom_filter_strategy->filter, my_tid,
+                     args->nthreads, &from, &to);
+        bloom_filter_merge(args->bloom_filter_strategy,
+                           args->local_filter_strategies, args->nthreads, from,
+                           to);
+        BARRIER_ARRIVE(args->barrier, rv);
+        bloom_filter_destroy(args->build_filter_strategy);
+#ifndef NO_TIMING
+        if (my_tid == 0) stopTimer(&args->filter_merge_timer);
+#endif
+    }
+
+    /* an exact filter is allocated by thread-0 over the key range of R found
+       in pass-1, then all threads insert their part of R */
+    if (args->key_ranges) {
+        if (my_tid == 0) {
+            intkey_t min = 1, max = 0; /* empty */
+            for (i = 0; i < args->nthreads; i++) {
+                const intkey_t * range = args->key_ranges[i];
+                if (range[0] > range[1]) continue;
+                if (min > max) {
+                    min = range[0];
+                    max = range[1];
+                } else {
+                    min = MIN(min, range[0]);
+                    max = MAX(max, range[1]);
+                }
+            }
+            if (bloom_filter_exact_init(args->bloom_filter_strategy, min,
+                                        max)) {
+                fprintf(stdout, "Exact filter size: %lu bits (%.2f bits/key)\n",
+                        args->bloom_filter_strategy->filter->m,
+                        args->bloom_filter_strategy->filter->m
+                            / (double) args->totalR);
+            }
+        }
+        BARRIER_ARRIVE(args->barrier, rv);
+        if (args->bloom_filter_strategy->filter->lazy_clear) {
+            filter_clear_share(args->bloom_filter_strategy, my_tid,
+                               args->nthreads);
+            BARRIER_ARRIVE(args->barrier, rv);
+        }
+        /* the filter might have fallen back to another variant */
+        args->filter_scan = select_filter_scan(args->bloom_filter_strategy);
+#ifndef NO_TIMING
+        resumeTimer(&args->filter_add_timer);
+#endif
+        bloom_filter_insert(args->bloom_filter_strategy, args->relR,
+                            args->numR);
+#ifndef NO_TIMING
+        stopTimer(&args->filter_add_timer);
+#endif
+        BARRIER_ARRIVE(args->barrier, rv);
+    }
+
+    /* a static filter is built by thread-0 from all keys of R at once */
+    if (!args->partition_filter_strategy && !args->filter_loaded
+        && !args->key_ranges
+        && bloom_filter_is_static(args->bloom_filter_strategy)) {
+        if (my_tid == 0) {
+            bloom_filter_t * filter = args->bloom_filter_strategy->filter;
+#ifndef NO_TIMING
+            resumeTimer(&args->filter_add_timer);
+#endif
+            bloom_filter_build(args->bloom_filter_strategy, args->relR,
+                               args->totalR);
+#ifndef NO_TIMING
+            stopTimer(&args->filter_add_timer);
+#endif
+            fprintf(stdout, "Static filter size: %lu bits (%.2f bits/key)\n",
+                    filter->nblocks * 3 * 8,
+                    filter->nblocks * 3 * 8 / (double) args->totalR);
+        }
+        BARRIER_ARRIVE(args->barrier, rv);
+    }
+#ifndef NO_TIMING
+    if (my_tid == 0) stopTimer(&args->filter_build_timer);
+#endif
+
+    /* the first thread of each NUMA node copies the filter into a replica on
+       its node, S is then probed by all threads against their local replica */
+    if (args->filter_replicas) {
+#ifndef NO_TIMING
+        if (my_tid == 0) startTimer(&args->filter_replicate_timer);
+#endif
+        int first = 1;
+        for (i = 0; i < my_tid; i++) {
+            if (get_numa_id(i) == numaid) first = 0;
+        }
+        if (first) {
+            args->filter_replicas[numaid] =
+                bloom_filter_replicate(args->bloom_filter_strategy);
+        }
+        BARRIER_ARRIVE(args->barrier, rv);
+        args->bloom_filter_strategy = args->filter_replicas[numaid];
+#ifndef NO_TIMING
+        if (my_tid == 0) stopTimer(&args->filter_replicate_timer);
+#endif
+    }
+
     /* 2. partitioning for relation S */
     part.rel          = args->relS;
     part.tmp          = args->tmpS;
@@ -1160,6 +2164,8 @@ prj_thread(void * param)
     part.num_tuples   = args->numS;
     part.total_tuples = args->totalS;
     part.relidx       = 1;
+    part.usage = args->partition_filter_strategy ? IGNORE : CHECK;
+    part.ranges = NULL;
 
 #ifdef USE_SWWC_OPTIMIZED_PART
     parallel_radix_partition_optimized(&part);
@@ -1187,8 +2193,8 @@ prj_thread(void * param)
         /* int counts[4] = {0, 0, 0, 0}; */
         uint64_t filtered = 0;
         for (i = 0; i < fanOut; i++) {
-            int32_t ntupR = outputR[i + 1] - outputR[i] - PADDING_TUPLES;
-            int32_t ntupS = outputS[i + 1] - outputS[i] - PADDING_TUPLES;
+            int32_t ntupR = outputR[i + 1] - outputR[i] - part.padding;
+            int32_t ntupS = outputS[i + 1] - outputS[i] - part.padding;
 
             filtered += ntupS;
 
@@ -1201,11 +2207,12 @@ prj_thread(void * param)
 
                 t->relR.num_tuples = t->tmpR.num_tuples = ntupR;
                 t->relR.tuples = args->tmpR + outputR[i];
-                t->tmpR.tuples = args->relR + outputR[i];
+                t->tmpR.tuples = args->pass2R + outputR[i];
 
                 t->relS.num_tuples = t->tmpS.num_tuples = ntupS;
                 t->relS.tuples = args->tmpS + outputS[i];
-                t->tmpS.tuples = args->relS + outputS[i];
+                t->tmpS.tuples = args->pass2S + outputS[i];
+                t->radixbits   = R;
 
                 task_queue_add(skew_queue, t);
             } else
@@ -1238,11 +2245,12 @@ prj_thread(void * param)
 
                 t->relR.num_tuples = t->tmpR.num_tuples = ntupR;
                 t->relR.tuples = args->tmpR + outputR[i];
-                t->tmpR.tuples = args->relR + outputR[i];
+                t->tmpR.tuples = args->pass2R + outputR[i];
 
                 t->relS.num_tuples = t->tmpS.num_tuples = ntupS;
                 t->relS.tuples = args->tmpS + outputS[i];
-                t->tmpS.tuples = args->relS + outputS[i];
+                t->tmpS.tuples = args->pass2S + outputS[i];
+                t->radixbits   = R;
 
                 task_queue_add(numalocal_part_queue, t);
             }
@@ -1250,7 +2258,9 @@ prj_thread(void * param)
 
         /* debug partitioning task queue */
         DEBUGMSG(1, "Pass-2: # partitioning tasks = %d\n", part_queue->count);
-        fprintf(stdout, "S-tuples after filter: %d\n", filtered);
+        /* partition-local filters are reported after pass-2 */
+        if (!args->partition_filter_strategy)
+            fprintf(stdout, "S-tuples after filter: %lu\n", filtered);
 
         /* DEBUG NUMA MAPPINGS */
         /* printf("Correct NUMA-mappings = %d, Wrong = %d\n", */
@@ -1278,8 +2288,19 @@ prj_thread(void * param)
 #elif NUM_PASSES == 2
 
     while ((task = task_queue_get_atomic(part_queue))) {
-
-        serial_radix_partition(task, join_queue, R, D);
+        const int d = args->pass2_target
+                          ? pass2_radixbits(task->relR.num_tuples,
+                                            args->pass2_target)
+                          : PASS2RADIXBITS;
+        args->pass2_fanouts[d]++;
+        if (args->partition_filter_strategy)
+            bloom_filter_reset(args->partition_filter_strategy);
+
+        args->filtered += serial_radix_partition(
+            task, join_queue, R, d, args->partition_filter_strategy,
+            args->filter_scan, args->semi_filter_strategy,
+            args->semi_filter_scan, &args->removedR, &args->joinpairs,
+            &args->jointasks);
     }
 
 #else
@@ -1333,6 +2354,7 @@ prj_thread(void * param)
                                 : numperthr;
         part.total_tuples = (*args->skewtask)->relR.num_tuples;
         part.relidx       = 2; /* meaning this is pass-2, no syncstats */
+        part.usage        = IGNORE; /* S was filtered in pass-1 */
         parallel_radix_partition(&part);
 
         numperthr = (*args->skewtask)->relS.num_tuples / args->nthreads;
@@ -1347,6 +2369,7 @@ prj_thread(void * param)
                                 : numperthr;
         part.total_tuples = (*args->skewtask)->relS.num_tuples;
         part.relidx       = 2; /* meaning this is pass-2, no syncstats */
+        part.usage        = IGNORE;
         parallel_radix_partition(&part);
 
         /* wait at a barrier until each thread copies out */
@@ -1385,6 +2408,7 @@ prj_thread(void * param)
                         t->tmpS.tuples = (*args->skewtask)->relS.tuples
                                          + outputS[i]  //;
                                          + k * (ntupS / args->nthreads);
+                        t->radixbits   = NUM_RADIX_BITS;
 
                         task_queue_add(part_queue, t);
                     }
@@ -1398,6 +2422,7 @@ prj_thread(void * param)
                     t->relS.num_tuples = t->tmpS.num_tuples = ntupS;
                     t->relS.tuples = (*args->skewtask)->tmpS.tuples + outputS[i];
                     t->tmpS.tuples = (*args->skewtask)->relS.tuples + outputS[i];
+                    t->radixbits   = NUM_RADIX_BITS;
 
                     task_queue_add(join_queue, t);
 
@@ -1418,6 +2443,9 @@ prj_thread(void * param)
 
     free(outputR);
     free(outputS);
+    free(args->part_ranges.range);
+    if (args->partition_filter_strategy)
+        bloom_filter_destroy(args->partition_filter_strategy);
 
     SYNC_TIMER_STOP(&args->localtimer.sync4);
     /* wait at a barrier until all threads add all join tasks */
@@ -1457,8 +2485,7 @@ prj_thread(void * param)
         /* do the actual join. join method differs for different algorithms,
            i.e. bucket chaining, histogram-based, histogram-based with simd &
            prefetching  */
-        results += args->join_function(&task->relR, &task->relS, &task->tmpR,
-                                       chainedbuf, &args->timer2, &args->probe);
+        results += join_task(args, task, chainedbuf);
 
         args->parts_processed++;
     }
@@ -1486,6 +2513,16 @@ prj_thread(void * param)
     /* global finish time */
     SYNC_GLOBAL_STOP(&args->globaltimer->finish_time, my_tid);
 
+    /* fill ratio of the global filter, each thread counts a disjoint range */
+    if (args->filter_placement == PASS1_GLOBAL) {
+        uint64_t from, to;
+
+        filter_share(args->bloom_filter_strategy->filter, my_tid,
+                     args->nthreads, &from, &to);
+        args->filter_bits = bloom_filter_popcount(
+            args->bloom_filter_strategy->filter, from, to);
+    }
+
 #ifdef PERF_COUNTERS_NEW
     // if(my_tid == 0) {
     //     PCM_stop();
@@ -1546,6 +2583,103 @@ print_timing(uint64_t total, uint64_t build, uint64_t part, uint64_t numtuples,
     }
 }
 
+/**
+ * Derives the parameters of the partition-local filters from the arguments.
+ * The filter size m is split among the FANOUT_PASS1 partitions of pass-1 but
+ * is limited to half of the L2 cache, so the partitions being clustered fit
+ * next to the filter.
+ *
+ * @param args the arguments of the filter
+ * @return the arguments of a partition-local filter
+ */
+static bloom_filter_args_t
+partition_filter_args(const bloom_filter_args_t * args)
+{
+    bloom_filter_args_t part_args = *args;
+    uint64_t            min_m     = args->variant == BLOCKED
+                                         || args->variant == EXACT
+                                        ? args->B
+                                    : args->variant == REGISTER_BLOCKED
+                                            || args->variant == CUCKOO
+                                        ? 64
+                                    : args->variant == SECTORIZED
+                                        ? SECTORIZED_BLOCK_BITS
+                                        : CACHE_LINE_SIZE * 8;
+
+    part_args.m = MAX(MIN(args->m / FANOUT_PASS1, L2_CACHE_SIZE * 8 / 2)
+                          / min_m * min_m,
+                      min_m);
+    part_args.local_build = false;
+    part_args.prefilter_m = 0; /* the filters are cache resident already */
+    /* the keys of a radix partition span the whole key range of R */
+    if (args->variant == EXACT) part_args.variant = BLOCKED;
+    return part_args;
+}
+
+/**
+ * Derives the parameters of the semi-join filter that the S-tuples passing
+ * pass-1 are inserted into. A static (xor) or exact filter cannot be built
+ * while S is partitioned, and a cuckoo filter overflows on the duplicate keys
+ * of S and then passes every R-tuple. A blocked filter with cache line sized
+ * blocks is used instead of these three.
+ *
+ * @param args the arguments of the filter of R
+ * @return the arguments of the filter of S
+ */
+static bloom_filter_args_t
+semi_filter_args(const bloom_filter_args_t * args)
+{
+    bloom_filter_args_t semi_args = *args;
+
+    if (args->variant == XOR || args->variant == EXACT
+        || args->variant == CUCKOO) {
+        semi_args.variant = BLOCKED;
+        semi_args.B       = CACHE_LINE_SIZE * 8;
+        semi_args.m = (args->m + semi_args.B - 1) / semi_args.B * semi_args.B;
+    }
+    semi_args.local_build = false;
+    semi_args.prefilter_m = 0;
+    return semi_args;
+}
+
+/**
+ * Creates the global filter, or maps the one saved by an earlier run if a file
+ * is given. Exits if the saved filter does not match the arguments.
+ *
+ * @param args the arguments of the filter
+ * @return the empty or loaded filter
+ */
+static bloom_filter_strategy_t *
+global_filter_create(bloom_filter_args_t * args)
+{
+    bloom_filter_strategy_t * strategy;
+
+    if (!args->load_path) return bloom_filter_create(args, 42);
+
+    strategy = bloom_filter_load(args, args->load_path);
+    if (!strategy) exit(EXIT_FAILURE);
+    fprintf(stdout, "Filter loaded from %s\n", args->load_path);
+    return strategy;
+}
+
+/**
+ * Saves the global filter once R is inserted, if a file is given and the
+ * filter was not loaded itself.
+ *
+ * @param args the arguments of the filter
+ * @param strategy the built filter
+ */
+static void
+global_filter_save(const bloom_filter_args_t * args,
+                   const bloom_filter_strategy_t * strategy)
+{
+    if (!args->save_path || args->load_path) return;
+
+    if (bloom_filter_save(strategy, args->save_path) == 0) {
+        fprintf(stdout, "Filter saved to %s\n", args->save_path);
+    }
+}
+
 /**
  * The template function for different joins: Basically each parallel radix join
  * has a initialization step, partitioning step and build-probe steps. All our
@@ -1569,18 +2703,80 @@ join_init_run(relation_t * relR, relation_t * relS, JoinFunction jf,
     arg_t             args[nthreads];
 
     int32_t **histR, **histS;
-    tuple_t * tmpRelR, *tmpRelS;
+    tuple_t * tmpRelR, *tmpRelS, *pass2RelR, *pass2RelS;
     int32_t   numperthr[2];
     int64_t   result = 0;
 
-    bloom_filter_strategy_t * bloom_filter_strategy;
+    bloom_filter_strategy_t *  bloom_filter_strategy;
+    bloom_filter_strategy_t ** local_filter_strategies = NULL;
+    bloom_filter_strategy_t ** filter_replicas         = NULL;
+    bloom_filter_strategy_t *  semi_filter_strategy    = NULL;
+    intkey_t(*key_ranges)[2]                           = NULL;
+    intkey_t(*thread_part_ranges)[2]                   = NULL;
+    FilterScanFunction         filter_scan, semi_filter_scan = NULL;
 
     /* task_queue_t * part_queue, * join_queue; */
     int            numnuma = get_num_numa_regions();
     task_queue_t * part_queue[numnuma];
     task_queue_t * join_queue[numnuma];
 
-    bloom_filter_strategy = bloom_filter_create(bloom_filter_args, 42);
+    /* R-tuples per pass-2 partition whose hash table fits its share of L2,
+       see PASS2_L2_SHARE, 0 keeps the fixed PASS2RADIXBITS */
+    long     l2           = get_cache_size(2);
+    uint64_t pass2_target = 0;
+    if (bloom_filter_args->adaptive_pass2) {
+        pass2_target = (l2 > 0 ? l2 : L2_CACHE_SIZE) / PASS2_L2_SHARE
+                       / (sizeof(tuple_t) + 2 * sizeof(int32_t));
+    }
+    /* the adaptive fanout needs more padding than the input relations have,
+       pass-2 then writes to buffers of its own instead */
+    const size_t padding = pass2_target ? PASS2_MAX_RELATION_PADDING
+                                        : RELATION_PADDING;
+
+#if NUM_PASSES == 2
+    if (bloom_filter_args->placement == PASS2_LOCAL) {
+        /* only a template for the partition-local filters of the threads */
+        bloom_filter_args_t part_args = partition_filter_args(bloom_filter_args);
+        bloom_filter_strategy         = bloom_filter_create(&part_args, 42);
+        DEBUGMSG(1, "Partition-local filters with m=%lu\n", part_args.m);
+    } else
+#endif
+    {
+        /* the threads clear the bitmap, see filter_clear_share */
+        bloom_filter_args_t global_args = *bloom_filter_args;
+        global_args.lazy_clear          = true;
+        bloom_filter_strategy           = global_filter_create(&global_args);
+    }
+    filter_scan = select_filter_scan(bloom_filter_strategy);
+    if (bloom_filter_args->local_build && !bloom_filter_args->load_path
+        && bloom_filter_args->placement == PASS1_GLOBAL) {
+        local_filter_strategies = (bloom_filter_strategy_t **) malloc(
+            nthreads * sizeof(bloom_filter_strategy_t *));
+    }
+    if (bloom_filter_args->replicate
+        && bloom_filter_args->placement == PASS1_GLOBAL) {
+        /* nodes without threads keep a NULL replica */
+        filter_replicas = (bloom_filter_strategy_t **) calloc(
+            numnuma, sizeof(bloom_filter_strategy_t *));
+    }
+    if (bloom_filter_args->variant == EXACT && !bloom_filter_args->load_path
+        && bloom_filter_args->placement == PASS1_GLOBAL) {
+        key_ranges = malloc(nthreads * sizeof(*key_ranges));
+    }
+    if (bloom_filter_args->prune
+        && bloom_filter_args->placement == PASS1_GLOBAL) {
+        thread_part_ranges =
+            malloc(nthreads * FANOUT_PASS1 * sizeof(*thread_part_ranges));
+    }
+#if NUM_PASSES == 2
+    if (bloom_filter_args->semi_join
+        && bloom_filter_args->placement == PASS1_GLOBAL) {
+        bloom_filter_args_t semi_args = semi_filter_args(bloom_filter_args);
+        semi_args.lazy_clear          = true;
+        semi_filter_strategy          = bloom_filter_create(&semi_args, 43);
+        semi_filter_scan = select_filter_scan(semi_filter_strategy);
+    }
+#endif
 #ifdef SKEW_HANDLING
     task_queue_t * skew_queue;
     task_t *       skewtask = NULL;
@@ -1602,20 +2798,29 @@ join_init_run(relation_t * relR, relation_t * relS, JoinFunction jf,
 
     /* allocate temporary space for partitioning */
     tmpRelR = (tuple_t *) alloc_aligned(
-        relR->num_tuples * sizeof(tuple_t) + RELATION_PADDING);
+        relR->num_tuples * sizeof(tuple_t) + padding);
     tmpRelS = (tuple_t *) alloc_aligned(
-        relS->num_tuples * sizeof(tuple_t) + RELATION_PADDING);
+        relS->num_tuples * sizeof(tuple_t) + padding);
     MALLOC_CHECK((tmpRelR && tmpRelS));
+    pass2RelR = relR->tuples;
+    pass2RelS = relS->tuples;
+    if (pass2_target) {
+        pass2RelR = (tuple_t *) alloc_aligned(
+            relR->num_tuples * sizeof(tuple_t) + padding);
+        pass2RelS = (tuple_t *) alloc_aligned(
+            relS->num_tuples * sizeof(tuple_t) + padding);
+        MALLOC_CHECK((pass2RelR && pass2RelS));
+    }
     /** Not an elegant way of passing whether we will numa-localize, but this
         feature is experimental anyway. */
     if (numalocalize) {
         uint64_t numwithpad;
 
-        numwithpad = (relR->num_tuples * sizeof(tuple_t) + RELATION_PADDING)
+        numwithpad = (relR->num_tuples * sizeof(tuple_t) + padding)
                      / sizeof(tuple_t);
         numa_localize(tmpRelR, numwithpad, nthreads);
 
-        numwithpad = (relS->num_tuples * sizeof(tuple_t) + RELATION_PADDING)
+        numwithpad = (relS->num_tuples * sizeof(tuple_t) + padding)
                      / sizeof(tuple_t);
         numa_localize(tmpRelS, numwithpad, nthreads);
     }
@@ -1654,13 +2859,15 @@ join_init_run(relation_t * relR, relation_t * relS, JoinFunction jf,
         CPU_SET(cpu_idx, &set);
         pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &set);
 
-        args[i].relR  = relR->tuples + i * numperthr[0];
-        args[i].tmpR  = tmpRelR;
-        args[i].histR = histR;
+        args[i].relR   = relR->tuples + i * numperthr[0];
+        args[i].tmpR   = tmpRelR;
+        args[i].pass2R = pass2RelR;
+        args[i].histR  = histR;
 
-        args[i].relS  = relS->tuples + i * numperthr[1];
-        args[i].tmpS  = tmpRelS;
-        args[i].histS = histS;
+        args[i].relS   = relS->tuples + i * numperthr[1];
+        args[i].tmpS   = tmpRelS;
+        args[i].pass2S = pass2RelS;
+        args[i].histS  = histS;
 
         args[i].numR   = (i == (nthreads - 1))
                              ? (relR->num_tuples - i * numperthr[0])
@@ -1684,6 +2891,22 @@ join_init_run(relation_t * relR, relation_t * relS, JoinFunction jf,
         args[i].threadresult  = &(joinresult->resultlist[i]);
 
         args[i].bloom_filter_strategy = bloom_filter_strategy;
+        args[i].filter_scan           = filter_scan;
+        args[i].local_filter_strategies = local_filter_strategies;
+        args[i].filter_replicas         = filter_replicas;
+        args[i].semi_filter_strategy    = semi_filter_strategy;
+        args[i].semi_filter_scan        = semi_filter_scan;
+        args[i].key_ranges              = key_ranges;
+        args[i].thread_part_ranges      = thread_part_ranges;
+        args[i].filter_loaded           = bloom_filter_args->load_path
+                                && bloom_filter_args->placement == PASS1_GLOBAL;
+#if NUM_PASSES == 2
+        args[i].filter_placement = bloom_filter_args->placement;
+#else
+        args[i].filter_placement = PASS1_GLOBAL;
+#endif
+        args[i].bypass_threshold = bloom_filter_args->bypass_threshold;
+        args[i].pass2_target     = pass2_target;
 
         rv = pthread_create(&tid[i], &attr, prj_thread, (void *) &args[i]);
         if (rv) {
@@ -1707,6 +2930,124 @@ join_init_run(relation_t * relR, relation_t * relS, JoinFunction jf,
     joinresult->totalresults = result;
     joinresult->nthreads     = nthreads;
 
+    if (args[0].filter_placement == PASS2_LOCAL) {
+        uint64_t filtered = 0;
+        for (i = 0; i < nthreads; i++) {
+            filtered += args[i].filtered;
+        }
+        fprintf(stdout, "S-tuples after filter: %lu\n", filtered);
+    }
+    if (semi_filter_strategy) {
+        uint64_t removed = 0;
+        for (i = 0; i < nthreads; i++) {
+            removed += args[i].removedR;
+        }
+        fprintf(stdout, "R-tuples removed by semi-join filter: %lu\n", removed);
+    }
+#if NUM_PASSES == 2
+    {
+        uint64_t joinpairs = 0, jointasks = 0;
+        for (i = 0; i < nthreads; i++) {
+            joinpairs += args[i].joinpairs;
+            jointasks += args[i].jointasks;
+        }
+        fprintf(stdout,
+                "JOIN-TASKS (coalesced below %d tuples): %lu partition pairs "
+                "in %lu tasks\n",
+                (int) COALESCE_TASK_TUPLES, joinpairs, jointasks);
+
+        if (pass2_target) {
+            fprintf(stdout,
+                    "PASS2-RADIXBITS (partitions of R up to %lu tuples):",
+                    pass2_target);
+        } else {
+            fprintf(stdout, "PASS2-RADIXBITS (fixed):");
+        }
+        for (int d = 0; d <= PASS2_MAX_RADIXBITS; d++) {
+            uint64_t parts = 0;
+            for (i = 0; i < nthreads; i++) {
+                parts += args[i].pass2_fanouts[d];
+            }
+            fprintf(stdout, " %d:%lu", d, parts);
+        }
+        fprintf(stdout, "\n");
+    }
+#endif
+    if (thread_part_ranges) {
+        uint64_t pruned = 0;
+        int      empty  = 0;
+        for (i = 0; i < nthreads; i++) {
+            pruned += args[i].part_ranges.pruned;
+        }
+        /* a partition is empty if no thread has a key in it */
+        for (int p = 0; p < FANOUT_PASS1; p++) {
+            int used = 0;
+            for (i = 0; i < nthreads; i++) {
+                const intkey_t * range =
+                    thread_part_ranges[i * FANOUT_PASS1 + p];
+                used |= range[0] <= range[1];
+            }
+            empty += !used;
+        }
+        fprintf(stdout,
+                "S-tuples pruned by partition ranges: %lu (%d of %d "
+                "partitions of R empty)\n",
+                pruned, empty, FANOUT_PASS1);
+    }
+    if (args[0].filter_placement == PASS1_GLOBAL
+        && bloom_filter_strategy->prefilter) {
+        uint64_t checked = 0, prefilter_passed = 0, filter_passed = 0;
+        for (i = 0; i < nthreads; i++) {
+            checked += args[i].checked;
+            prefilter_passed += args[i].prefilter_passed;
+            filter_passed += args[i].filter_passed;
+        }
+        fprintf(stdout,
+                "FILTER-TIERS (%lu, %lu bits): tier-1 passed %lu of %lu "
+                "(%.4f), tier-2 passed %lu of %lu (%.4f)\n",
+                bloom_filter_strategy->prefilter->filter->m,
+                bloom_filter_strategy->filter->m, prefilter_passed, checked,
+                checked ? prefilter_passed / (double) checked : 0,
+                filter_passed, prefilter_passed,
+                prefilter_passed ? filter_passed / (double) prefilter_passed
+                                 : 0);
+    }
+    int bypassed = 0;
+    if (args[0].filter_placement == PASS1_GLOBAL
+        && bloom_filter_args->bypass_threshold < 1.0) {
+        double rate = 0;
+        for (i = 0; i < nthreads; i++) {
+            bypassed += args[i].bypassed;
+            rate += args[i].sampled_pass_rate / nthreads;
+        }
+        fprintf(stdout,
+                "FILTER-BYPASS (threshold %.2f): %d of %d threads, sampled "
+                "pass-through rate %.4f\n",
+                bloom_filter_args->bypass_threshold, bypassed, nthreads, rate);
+    }
+    {
+        uint64_t matched = 0, checked = 0, passed = 0, bits = 0;
+        for (i = 0; i < nthreads; i++) {
+            matched += args[i].matchedS;
+            checked += args[i].checked;
+            passed += args[0].filter_placement == PASS2_LOCAL
+                          ? args[i].filtered
+                          : args[i].filter_passed;
+            bits += args[i].filter_bits;
+        }
+        if (args[0].filter_placement == PASS2_LOCAL) {
+            /* each partition-local filter holds one pass-1 partition of R */
+            bloom_filter_print_health(bloom_filter_strategy,
+                                      relR->num_tuples / FANOUT_PASS1,
+                                      relS->num_tuples, passed, matched, 0);
+        } else {
+            /* the join of bypassed S-tuples finds their false positives too */
+            bloom_filter_print_health(bloom_filter_strategy, relR->num_tuples,
+                                      bypassed ? 0 : checked, passed, matched,
+                                      bits);
+        }
+    }
+
 #ifdef SYNCSTATS
     /* #define ABSDIFF(X,Y) (((X) > (Y)) ? ((X)-(Y)) : ((Y)-(X))) */
     fprintf(stdout, "TID JTASKS T1.1 T1.1-IDLE T1.2 T1.2-IDLE "
@@ -1739,6 +3080,30 @@ join_init_run(relation_t * relR, relation_t * relS, JoinFunction jf,
     uint64_t build = args[0].timer1 - probe - args[0].timer3;
     print_timing(args[0].timer1, build, args[0].timer3, relS->num_tuples, result,
                  &args[0].start, &args[0].partitioned, probe_usec, &args[0].end);
+    fprintf(stdout, "FILTER-BUILD, FILTER-MERGE (cycles, %s build): \n",
+            args[0].filter_placement == PASS2_LOCAL ? "partition-local"
+            : local_filter_strategies               ? "thread-local"
+                                                    : "shared");
+    fprintf(stdout, "%llu \t %llu \n", args[0].filter_build_timer,
+            args[0].filter_merge_timer);
+    if (args[0].filter_placement == PASS1_GLOBAL) {
+        uint64_t add = 0, check = 0;
+        for (i = 0; i < nthreads; i++) {
+            add += args[i].filter_add_timer / nthreads;
+            check += args[i].filter_check_timer / nthreads;
+        }
+        fprintf(stdout, "FILTER-ADD, FILTER-CONTAINS (cycles per thread, with "
+                        "histogram): \n");
+        fprintf(stdout, "%lu \t %lu \n", add, check);
+    }
+    if (filter_replicas) {
+        int nreplicas = 0;
+        for (i = 0; i < numnuma; i++) {
+            nreplicas += filter_replicas[i] != NULL;
+        }
+        fprintf(stdout, "FILTER-REPLICATE (cycles, %d replicas): \n", nreplicas);
+        fprintf(stdout, "%llu \n", args[0].filter_replicate_timer);
+    }
 
     // TODO: Print perf counter
 #endif
@@ -1768,6 +3133,23 @@ join_init_run(relation_t * relR, relation_t * relS, JoinFunction jf,
 #endif
     free(tmpRelR);
     free(tmpRelS);
+    if (pass2_target) {
+        free(pass2RelR);
+        free(pass2RelS);
+    }
+    if (args[0].filter_placement == PASS1_GLOBAL) {
+        global_filter_save(bloom_filter_args, bloom_filter_strategy);
+    }
+    free(local_filter_strategies);
+    free(key_ranges);
+    free(thread_part_ranges);
+    if (semi_filter_strategy) bloom_filter_destroy(semi_filter_strategy);
+    if (filter_replicas) {
+        for (i = 0; i < numnuma; i++) {
+            if (filter_replicas[i]) bloom_filter_destroy(filter_replicas[i]);
+        }
+        free(filter_replicas);
+    }
     bloom_filter_destroy(bloom_filter_strategy);
 
 #ifdef SYNCSTATS
@@ -1786,6 +3168,15 @@ BPRO(relation_t * relR, relation_t * relS, int nthreads,
                          bloom_filter_args);
 }
 
+/** \copydoc PROT */
+result_t *
+BPROT(relation_t * relR, relation_t * relS, int nthreads,
+      bloom_filter_args_t * bloom_filter_args)
+{
+    return join_init_run(relR, relS, bucket_chaining_tagged_join, nthreads,
+                         bloom_filter_args);
+}
+
 /** \copydoc PRH */
 result_t *
 BPRH(relation_t * relR, relation_t * relS, int nthreads,
@@ -1819,8 +3210,10 @@ BRJ(relation_t * relR, relation_t * relS, int nthreads,
 
     relation_t *              outRelR, *outRelS;
     bloom_filter_strategy_t * bloom_filter_strategy;
+    const uint64_t            numS     = relS->num_tuples;
+    uint64_t                  matchedS = 0;
 
-    bloom_filter_strategy = bloom_filter_create(bloom_filter_args, 42);
+    bloom_filter_strategy = global_filter_create(bloom_filter_args);
     outRelR               = (relation_t *) malloc(sizeof(relation_t));
     outRelS               = (relation_t *) malloc(sizeof(relation_t));
 
@@ -1847,11 +3240,21 @@ BRJ(relation_t * relR, relation_t * relS, int nthreads,
     timerclear(&probe);
 #endif
 
+    /* a static filter is built from all keys of R before partitioning */
+    bloom_filter_usage_t insert = INSERT;
+    if (bloom_filter_args->load_path) {
+        insert = IGNORE;
+    } else if (bloom_filter_is_static(bloom_filter_strategy)) {
+        bloom_filter_build(bloom_filter_strategy, relR->tuples,
+                           relR->num_tuples);
+        insert = IGNORE;
+    }
+
     /***** do the multi-pass partitioning *****/
 #if NUM_PASSES == 1
     /* apply radix-clustering on relation R for pass-1 */
     radix_cluster_nopadding(outRelR, relR, 0, NUM_RADIX_BITS,
-                            bloom_filter_strategy, INSERT);
+                            bloom_filter_strategy, insert);
     relR = outRelR;
 
     /* apply radix-clustering on relation S for pass-1 */
@@ -1867,7 +3270,7 @@ BRJ(relation_t * relR, relation_t * relS, int nthreads,
     /* apply radix-clustering on relation R for pass-2 */
     radix_cluster_nopadding(relR, outRelR, NUM_RADIX_BITS / NUM_PASSES,
                             NUM_RADIX_BITS - (NUM_RADIX_BITS / NUM_PASSES),
-                            bloom_filter_strategy, INSERT);
+                            bloom_filter_strategy, insert);
 
     /* apply radix-clustering on relation S for pass-1 */
     radix_cluster_nopadding(outRelS, relS, 0, NUM_RADIX_BITS / NUM_PASSES,
@@ -1930,8 +3333,9 @@ BRJ(relation_t * relR, relation_t * relS, int nthreads,
             tmpS.tuples     = relS->tuples + s;
             s += S_count_per_cluster[i];
 
-            result += bucket_chaining_join(&tmpR, &tmpS, NULL, chainedbuf,
-                                           &timer2, &probe);
+            result += bucket_chaining_join(&tmpR, &tmpS, NULL, NUM_RADIX_BITS,
+                                           NULL, chainedbuf, &timer2, &probe,
+                                           &matchedS);
         } else {
             r += R_count_per_cluster[i];
             s += S_count_per_cluster[i];
@@ -1954,6 +3358,12 @@ BRJ(relation_t * relR, relation_t * relS, int nthreads,
                  (probe.tv_sec * 1000000L + probe.tv_usec), &end);
 #endif
 
+    bloom_filter_print_health(
+        bloom_filter_strategy, relR->num_tuples, numS, relS->num_tuples,
+        matchedS,
+        bloom_filter_popcount(bloom_filter_strategy->filter, 0,
+                              bloom_filter_strategy->filter->m / 8));
+
     /* clean-up temporary buffers */
     free(S_count_per_cluster);
     free(R_count_per_cluster);
@@ -1966,6 +3376,7 @@ BRJ(relation_t * relR, relation_t * relS, int nthreads,
     free(outRelS);
 #endif
 
+    global_filter_save(bloom_filter_args, bloom_filter_strategy);
     bloom_filter_destroy(bloom_filter_strategy);
 
     joinresult->totalresults = result;
@@ -35,6 +35,23 @@ result_t *
 BPRO(relation_t * relR, relation_t * relS, int nthreads,
      bloom_filter_args_t * bloom_filter_args);
 
+/**
+ * PROT: Parallel Radix Join Optimized with Tagged buckets.
+ *
+ * Same as PRO, but every link of the bucket chains carries a 16-bit
+ * fingerprint of the R-tuple it points to. Probes skip the R-tuples whose
+ * fingerprint differs from the one of the S-key, which shortens the walk over
+ * long chains of non-unique keys and over chains probed by non-matching keys.
+
+ * @param relR  input relation R - inner relation
+ * @param relS  input relation S - inner relation
+ *
+ * @return number of result tuples
+ */
+result_t *
+BPROT(relation_t * relR, relation_t * relS, int nthreads,
+      bloom_filter_args_t * bloom_filter_args);
+
 /**
  * RJ: Radix Join.
  *
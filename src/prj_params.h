@@ -53,6 +53,16 @@
 #define L1_ASSOCIATIVITY 8
 #endif
 
+/** L2 cache size */
+#ifndef L2_CACHE_SIZE
+#define L2_CACHE_SIZE 1048576
+#endif
+
+/** last level cache size, used if it cannot be read from sysfs */
+#ifndef LLC_CACHE_SIZE
+#define LLC_CACHE_SIZE 33554432
+#endif
+
 /** number of tuples fitting into L1 */
 #define L1_CACHE_TUPLES (L1_CACHE_SIZE/sizeof(tuple_t))
 
@@ -63,6 +73,12 @@
 #define THRESHOLD1(NTHR) (NTHR*L1_CACHE_TUPLES)
 #define THRESHOLD2(NTHR) (NTHR*NTHR*L1_CACHE_TUPLES)
 
+/** pass-2 partition pairs with fewer R- and S-tuples than this are coalesced
+ *  into join tasks of up to this many tuples, 0 disables the coalescing */
+#ifndef COALESCE_TASK_TUPLES
+#define COALESCE_TASK_TUPLES L1_CACHE_TUPLES
+#endif
+
 /** }*/
 
 
@@ -91,6 +107,20 @@
 /** @warning This padding must be allocated at the end of relation */
 #define RELATION_PADDING (PADDING_TUPLES*FANOUT_PASS1*sizeof(tuple_t))
 
+/** most radix bits of pass-2 if the bloom join chooses its fanout per pass-1
+ *  partition from the size of the partition (--bloom-adaptive-pass2) */
+#ifndef PASS2_MAX_RADIXBITS
+#define PASS2_MAX_RADIXBITS (PASS2RADIXBITS + 2)
+#endif
+
+/** padding of the bloom join with an adaptive pass-2 fanout, which has room
+ *  for 1 << PASS2_MAX_RADIXBITS partitions of pass-2. Only its own buffers
+ *  are allocated with it, the other joins keep PADDING_TUPLES. */
+#define PASS2_MAX_PADDING_TUPLES \
+    (SMALL_PADDING_TUPLES*((1 << PASS2_MAX_RADIXBITS)+1))
+#define PASS2_MAX_RELATION_PADDING \
+    (PASS2_MAX_PADDING_TUPLES*FANOUT_PASS1*sizeof(tuple_t))
+
 /** \endinternal */
 
 
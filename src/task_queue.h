@@ -24,12 +24,21 @@ typedef struct task_t       task_t;
 typedef struct task_list_t  task_list_t;
 typedef struct task_queue_t task_queue_t;
 
+/* a partition pair of a coalesced task, offsets from relR/tmpR and relS */
+typedef struct {
+    uint32_t offR, numR;
+    uint32_t offS, numS;
+} task_pair_t;
+
 struct task_t {
-    relation_t relR;
-    relation_t tmpR;
-    relation_t relS;
-    relation_t tmpS;
-    task_t *   next;
+    relation_t    relR;
+    relation_t    tmpR;
+    relation_t    relS;
+    relation_t    tmpS;
+    task_t *      next;
+    int32_t       radixbits; /* low key bits the relations are partitioned by */
+    task_pair_t * pairs;     /* pairs of a coalesced task, NULL otherwise */
+    int32_t       npairs;
 };
 
 struct task_list_t {
@@ -94,7 +103,7 @@ inline void
 task_queue_copy_atomic(task_queue_t * tq, task_t * t)
     __attribute__((always_inline));
 
-/* get a free slot of task_t */
+/* get a free slot of task_t, slots start zeroed */
 inline task_t *
 task_queue_get_slot_atomic(task_queue_t * tq) __attribute__((always_inline));
 
@@ -232,7 +241,7 @@ task_queue_get_slot(task_queue_t * tq)
         l->curr++;
     } else {
         task_list_t * nl = (task_list_t *) malloc(sizeof(task_list_t));
-        nl->tasks        = (task_t *) malloc(tq->alloc_size * sizeof(task_t));
+        nl->tasks        = (task_t *) calloc(tq->alloc_size, sizeof(task_t));
         nl->curr         = 1;
         nl->next         = tq->free_list;
         tq->free_list    = nl;
@@ -242,7 +251,7 @@ task_queue_get_slot(task_queue_t * tq)
     return ret;
 }
 
-/* get a free slot of task_t */
+/* get a free slot of task_t, slots start zeroed */
 inline task_t *
 task_queue_get_slot_atomic(task_queue_t * tq)
 {
@@ -259,7 +268,7 @@ task_queue_init(int alloc_size)
 {
     task_queue_t * ret    = (task_queue_t *) malloc(sizeof(task_queue_t));
     ret->free_list        = (task_list_t *) malloc(sizeof(task_list_t));
-    ret->free_list->tasks = (task_t *) malloc(alloc_size * sizeof(task_t));
+    ret->free_list->tasks = (task_t *) calloc(alloc_size, sizeof(task_t));
     ret->free_list->curr  = 0;
     ret->free_list->next  = NULL;
     ret->count            = 0;
@@ -3,13 +3,19 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "bloom_filter.h"
+#include "bloom_filter_kernels.h"
 #include "fort.h"
 #include "generator.h"
 #include "hash.h"
+#include "parallel_radix_join.h"
+#include "parallel_radix_join_bloom.h"
+#include "prj_params.h"
 #include "rdtsc.h"
 
 static inline void
@@ -23,10 +29,19 @@ assert(bool cond, char * msg, ...)
     va_end(args);
 }
 
-static inline uint32_t
-mod_m(uint32_t val, uint64_t m)
+/** the SIMD paths of the filter kernels this test binary is compiled with */
+#if defined(__AVX512F__)
+#define SIMD_PATHS "AVX-512"
+#elif defined(__AVX2__)
+#define SIMD_PATHS "AVX2"
+#else
+#define SIMD_PATHS "scalar"
+#endif
+
+static inline uint64_t
+rand64()
 {
-    return val & (m - 1);
+    return (uint64_t) rand() << 62 ^ (uint64_t) rand() << 31 ^ rand();
 }
 
 /**
@@ -48,16 +63,17 @@ test_hash(int seed, uint32_t n_samples)
         outstream,
         "algorithm;time_total_ms;time_single_ns;collisions;collisions_pct\n");
 
-    hash_fn_t hash_fns[10] = {hash_crc,           hash_FNV,
+    hash_fn_t hash_fns[12] = {hash_crc,           hash_FNV,
                               hash_crapwow,       hash_Coffin,
                               hash_MurmurOAAT_32, hash_JenkinsOAAT_32,
                               hash_Spooky,        hash_KR_v2,
-                              hash_DJB2,          hash_x17};
+                              hash_DJB2,          hash_x17,
+                              hash_murmur,        hash_mulshift};
 
-    char * names[10] = {"crc",        "FNV",           "crapwow",
+    char * names[12] = {"crc",        "FNV",           "crapwow",
                         "Coffin",     "MurmurOAAT_32", "JenkinsOAAT_32",
                         "SpookyHash", "KR_v2",         "DJB2",
-                        "x17"};
+                        "x17",        "murmur",        "mulshift"};
 
     for (int i = 0; i < n_samples; i++) {
         inputs[i] = rand();
@@ -74,7 +90,7 @@ test_hash(int seed, uint32_t n_samples)
         }
     }
 
-    for (int i = 0; i < 10; i++) {
+    for (int i = 0; i < 12; i++) {
         /* timing */
         struct timeval start, end;
         hash_fn_t      hash = hash_fns[i];
@@ -109,8 +125,52 @@ test_hash(int seed, uint32_t n_samples)
         free(hit_counts);
     }
 
+    /* the vectorized multiply-shift of the filters hashes whole tuples */
+    tuple_t *  tuples = malloc(n_samples * sizeof(tuple_t));
+    uint32_t * hashes = malloc(n_samples * sizeof(uint32_t));
+    for (int i = 0; i < n_samples; i++) {
+        tuples[i].key     = inputs[i];
+        tuples[i].payload = i;
+        hashes[i]         = 0; /* page faults are not timed */
+    }
+
+    struct timeval start, end;
+    gettimeofday(&start, NULL);
+    hash_mulshift_batch(seed, tuples, n_samples, hashes);
+    gettimeofday(&end, NULL);
+
+    uint32_t mismatches = 0;
+    for (int j = 0; j < n_samples; j++) {
+        mismatches += hashes[j] != hash_mulshift(seed, tuples[j].key);
+    }
+    if (mismatches) {
+        printf("[ERROR] mulshift_batch differs from mulshift for %u keys\n",
+               mismatches);
+    }
+
+    char * hit_counts = calloc(UINT32_MAX, sizeof(char));
+    for (int j = 0; j < n_samples; j++) {
+        hit_counts[hashes[j]] += 1;
+    }
+    uint32_t collisions = 0;
+    for (uint32_t j = 0; j < UINT32_MAX; j++) {
+        if (hit_counts[j] > 1) {
+            collisions += hit_counts[j] - 1;
+        }
+    }
+    collisions -= in_collisions;
+    free(hit_counts);
+
+    uint64_t diff = (end.tv_sec - start.tv_sec) * 1000000 + end.tv_usec
+                    - start.tv_usec;
+    fprintf(outstream, "%s;%.2f;%.2f;%d;%.2f\n", "mulshift_batch",
+            diff / 1000.0, (diff / (float) n_samples) * 1000, collisions,
+            collisions / (float) n_samples * 100);
+
     fflush(outstream);
 
+    free(tuples);
+    free(hashes);
     free(inputs);
     free(outputs);
 }
@@ -150,6 +210,30 @@ test_enhanced_double_hashing(int seed, uint32_t n_samples)
     fflush(stdout);
 }
 
+/** the filter arguments of the tests: a global filter without options */
+static void
+test_filter_args(bloom_filter_args_t * args, bloom_filter_variant_t variant,
+                 uint64_t m, uint64_t k)
+{
+    args->m                = m;
+    args->k                = k;
+    args->variant          = variant;
+    args->B                = 512;
+    args->local_build      = false;
+    args->placement        = PASS1_GLOBAL;
+    args->bypass_threshold = 1.0;
+    args->replicate        = false;
+    args->save_path        = NULL;
+    args->load_path        = NULL;
+    args->semi_join        = false;
+    args->prefilter_m      = 0;
+    args->prefilter_k      = 0;
+    args->lazy_clear       = false;
+    args->hash             = HASH_CRAPWOW;
+    args->prune            = false;
+    args->adaptive_pass2   = false;
+}
+
 // using knuth algorithm, see https://stackoverflow.com/a/1608585
 void
 random_unique_gen_range(relation_t * R, intkey_t min, intkey_t max)
@@ -194,10 +278,7 @@ test_bloom_fpr(ft_table_t * table, uint32_t seed, uint64_t m, uint64_t k,
 {
     srand(seed);
     bloom_filter_args_t args;
-    args.m                                 = m;
-    args.k                                 = k;
-    args.variant                           = variant;
-    args.B                                 = 512;
+    test_filter_args(&args, variant, m, k);
     bloom_filter_strategy_t * filter_strat = bloom_filter_create(&args, rand());
     bloom_filter_t *          filter       = filter_strat->filter;
 
@@ -206,8 +287,13 @@ test_bloom_fpr(ft_table_t * table, uint32_t seed, uint64_t m, uint64_t k,
     uint64_t n_samples    = S->num_tuples;
 
     clock_t start_add = clock();
-    for (uint32_t i = 0; i < n_insertions; i++) {
-        filter_strat->add(filter, R->tuples[i].key);
+    if (bloom_filter_is_static(filter_strat)) {
+        bloom_filter_build(filter_strat, R->tuples, n_insertions);
+        filter = filter_strat->filter; /* an exact filter may fall back */
+    } else {
+        for (uint32_t i = 0; i < n_insertions; i++) {
+            filter_strat->add(filter, R->tuples[i].key);
+        }
     }
     clock_t end_add = clock();
 
@@ -218,26 +304,126 @@ test_bloom_fpr(ft_table_t * table, uint32_t seed, uint64_t m, uint64_t k,
     }
     clock_t end_contains = clock();
 
+    /* the batched lookup has to find the same tuples */
+    uint64_t * sel = malloc(BLOOM_SEL_WORDS(n_samples) * sizeof(uint64_t));
+    bloom_selection_fill(sel, n_samples);
+    clock_t  start_batch = clock();
+    uint64_t pos_batch = filter_strat->contains_batch(filter, S->tuples,
+                                                      n_samples, sel);
+    clock_t  end_batch = clock();
+    free(sel);
+    assert(pos_batch == pos, "contains_batch found %lu instead of %u tuples\n",
+           pos_batch, pos);
+
     uint32_t neg = n_samples * (1 - selectivity);
     uint32_t tp  = n_samples - neg;
     uint32_t fp  = pos - tp;
     double   fpr = fp / ((double) neg);
 
+    /* a filter must never miss an inserted key */
+    uint32_t found = 0;
+    for (uint32_t i = 0; i < n_insertions; i++) {
+        found += filter_strat->contains(filter, R->tuples[i].key);
+    }
+    assert(found == n_insertions, "filter misses %u of %lu inserted keys\n",
+           n_insertions - found, n_insertions);
+
+    /* the model of the filter, a cuckoo filter that overflowed passes every
+       key */
+    const double model_fpr = bloom_filter_expected_fpr(filter_strat,
+                                                       n_insertions);
     bloom_filter_destroy(filter_strat);
 
-    char *k_str, *real_fpr, *expected_fpr, *time_add, *time_contains;
+    char *k_str, *real_fpr, *expected_fpr, *time_add, *time_contains,
+        *time_lookup, *time_lookup_batch;
     asprintf(&k_str, "%lu", k);
     asprintf(&real_fpr, "%.3f%%", fpr * 100);
-    asprintf(&expected_fpr, "%.3f%%",
-             pow(1 - pow(1 - 1 / (double) m, k * n_insertions), k) * 100);
+    if (variant == XOR) {
+        asprintf(&expected_fpr, "%.3f%%", pow(2, -8) * 100);
+    } else if (variant == CUCKOO || variant == SECTORIZED) {
+        asprintf(&expected_fpr, "%.3f%%", model_fpr * 100);
+    } else {
+        asprintf(&expected_fpr, "%.3f%%",
+                 pow(1 - pow(1 - 1 / (double) m, k * n_insertions), k) * 100);
+    }
     asprintf(&time_add, "%.4f",
              (end_add - start_add) / (float) n_insertions / k * 1000000.0);
     asprintf(&time_contains, "%.4f",
              (end_contains - start_contains) / (float) n_samples * 1000000.0);
+    asprintf(&time_lookup, "%.2f",
+             (end_contains - start_contains) / (double) CLOCKS_PER_SEC
+                 / n_samples * 1e9);
+    asprintf(&time_lookup_batch, "%.2f",
+             (end_batch - start_batch) / (double) CLOCKS_PER_SEC / n_samples
+                 * 1e9);
 
     ft_write_ln(table, "", "", "", "", k_str, real_fpr, expected_fpr, time_add,
-                time_contains);
+                time_contains, time_lookup, time_lookup_batch);
+}
+
+/**
+ * @brief Runs the FPR test for all variants of filters and k up to k_max
+ *
+ * @param keys describes the keys in R and S, appended to the variant name
+ */
+void
+test_bloom_fpr_variants(ft_table_t * table, int seed, uint64_t m,
+                        uint64_t k_max, relation_t * R, relation_t * S,
+                        const char * keys)
+{
+    const char * names[] = {"blocked",    "register",     "sectorized",
+                            "cuckoo",     "xor (static)", "basic"};
+    const bloom_filter_variant_t variants[] = {BLOCKED, REGISTER_BLOCKED,
+                                               SECTORIZED, CUCKOO, XOR, BASIC};
+    char *r_str, *s_str;
+    asprintf(&r_str, "%lu", R->num_tuples);
+    asprintf(&s_str, "%lu", S->num_tuples);
+
+    for (int v = 0; v < 6; v++) {
+        char *   name, *m_str;
+        uint64_t mv = m;
+        /* the cuckoo filter holds at most m / CUCKOO_FINGERPRINT_BITS keys,
+           keep its slots below 90% full so that inserts do not fail */
+        if (variants[v] == CUCKOO) {
+            while (mv / CUCKOO_FINGERPRINT_BITS * 9 / 10 < R->num_tuples)
+                mv <<= 1;
+        }
+        asprintf(&name, "%s%s", names[v], keys);
+        asprintf(&m_str, "%lu", mv);
+        ft_write_ln(table, m_str, r_str, s_str, name, "", "", "", "", "", "",
+                    "");
+        /* k is not used by the cuckoo filter, m and k not by the xor filter */
+        const uint64_t ks = variants[v] == CUCKOO || variants[v] == XOR
+                                ? 1
+                                : k_max;
+        for (uint64_t k = 1; k <= ks; k += 1) {
+            test_bloom_fpr(table, seed, mv, k, variants[v], R, S);
+        }
+        free(name);
+        free(m_str);
+    }
+    free(r_str);
+    free(s_str);
+}
+
+#ifdef KEY_8B
+/**
+ * @brief Spreads the keys of a relation over 64 bits, keeping them unique and
+ * R and S disjoint. With upper, the keys are moved into the upper 32 bits and
+ * all of them share the lower ones, so a hash that truncates 8-byte keys to
+ * 32 bits maps all of them to the same bits. Otherwise the keys are scattered
+ * over the whole range by a multiplication with an odd constant.
+ */
+void
+spread_keys_8b(relation_t * rel, bool upper)
+{
+    for (uint64_t i = 0; i < rel->num_tuples; i++) {
+        const uint64_t key = rel->tuples[i].key;
+        rel->tuples[i].key = upper ? key << 32 | 0x2545f491
+                                   : key * 0x9e3779b97f4a7c15ULL;
+    }
 }
+#endif
 
 void
 test_bloom_fpr_wrapper(int seed, uint64_t m, uint64_t k_max, uint32_t n_samples,
@@ -250,12 +436,8 @@ test_bloom_fpr_wrapper(int seed, uint64_t m, uint64_t k_max, uint32_t n_samples,
     ft_set_cell_prop(table, 0, FT_ANY_COLUMN, FT_CPROP_ROW_TYPE, FT_ROW_HEADER);
     ft_write_ln(table, "bloom-size", "r-size", "s-size", "bloom-filter",
                 "bloom-hashes", "fpr_emp", "fpr_theo", "time (us) add per k",
-                "time (us) contains total");
-    char *m_str, *r_str, *s_str;
-    asprintf(&m_str, "%u", m);
-    asprintf(&r_str, "%u", n_insertions);
-    asprintf(&s_str, "%u", n_samples);
-
+                "time (us) contains total", "time (ns) per lookup",
+                "time (ns) per lookup (batch)");
     relation_t R, S;
     R.tuples     = malloc(n_insertions * sizeof(tuple_t));
     R.num_tuples = n_insertions;
@@ -267,14 +449,17 @@ test_bloom_fpr_wrapper(int seed, uint64_t m, uint64_t k_max, uint32_t n_samples,
     random_unique_gen_range(&R, 0, threshold);
     random_unique_gen_range(&S, threshold + 1, INT32_MAX);
 
-    ft_write_ln(table, m_str, r_str, s_str, "blocked", "", "", "", "", "");
-    for (int k = 1; k <= k_max; k += 1) {
-        test_bloom_fpr(table, seed, m, k, BLOCKED, &R, &S);
-    }
-    ft_write_ln(table, m_str, r_str, s_str, "basic", "", "", "", "", "");
-    for (int k = 1; k <= k_max; k += 1) {
-        test_bloom_fpr(table, seed, m, k, BASIC, &R, &S);
-    }
+    test_bloom_fpr_variants(table, seed, m, k_max, &R, &S, "");
+#ifdef KEY_8B
+    /* the same keys moved into the upper half, all keys share the lower one */
+    spread_keys_8b(&R, true);
+    spread_keys_8b(&S, true);
+    test_bloom_fpr_variants(table, seed, m, k_max, &R, &S, ", upper 32 bits");
+    /* and scattered over the whole 64-bit range */
+    spread_keys_8b(&R, false);
+    spread_keys_8b(&S, false);
+    test_bloom_fpr_variants(table, seed, m, k_max, &R, &S, ", 64-bit range");
+#endif
     free(S.tuples);
     free(R.tuples);
 
@@ -282,12 +467,374 @@ test_bloom_fpr_wrapper(int seed, uint64_t m, uint64_t k_max, uint32_t n_samples,
     ft_destroy_table(table);
 }
 
+/**
+ * @brief Joins R and S that share n unique keys in one pass-1 partition, whose
+ * pass-2 clusters are small, large and small: the large pair is joined on its
+ * own while the small pairs on both sides of it are coalesced into join tasks,
+ * which must not touch the clusters of the large pair.
+ *
+ * @param seed seed for the filter
+ */
+void
+test_coalesced_join(int seed)
+{
+    /* pass-2 radix of the clusters and the keys in each of them, the large
+       one needs 2 or more pass-2 bits for L2 of up to 4 MiB */
+    const intkey_t radix[]   = {0, 1, 2};
+    const uint32_t ntuples[] = {100, 200000, 100};
+    const uint32_t n         = ntuples[0] + ntuples[1] + ntuples[2];
+
+    relation_t R, S;
+    R.tuples     = malloc(n * sizeof(tuple_t) + RELATION_PADDING);
+    R.num_tuples = n;
+    S.tuples     = malloc(n * sizeof(tuple_t) + RELATION_PADDING);
+    S.num_tuples = n;
+
+    bloom_filter_args_t args;
+    test_filter_args(&args, BLOCKED, 16777216, 2);
+
+    const char * names[] = {"PRO", "PROT", "PRH"};
+    result_t * (*joins[])(relation_t *, relation_t *, int,
+                          bloom_filter_args_t *) = {BPRO, BPROT, BPRH};
+    int correct = 0;
+    srand(seed);
+    for (int a = 0; a < 3; a++) {
+        /* pass-2 uses the input relations as scratch, refill them, S in
+           reverse order so that its clusters differ from the ones of R */
+        uint32_t pos = 0;
+        for (int c = 0; c < 3; c++) {
+            for (uint32_t j = 1; j <= ntuples[c]; j++, pos++) {
+                /* all keys fall into pass-1 partition 0 */
+                R.tuples[pos].key     = (intkey_t) j << NUM_RADIX_BITS
+                                    | radix[c] << PASS1RADIXBITS;
+                R.tuples[pos].payload = pos;
+                S.tuples[n - 1 - pos] = R.tuples[pos];
+            }
+        }
+
+        result_t * res = joins[a](&R, &S, 1, &args);
+        assert(res->totalresults == n, "%s found %ld instead of %u results\n",
+               names[a], res->totalresults, n);
+        correct += res->totalresults == n;
+#ifdef JOIN_RESULT_MATERIALIZE
+        free(res->resultlist);
+#endif
+        free(res);
+    }
+    printf("coalesced join: %d of 3 joins found all %u results\n", correct, n);
+
+    free(S.tuples);
+    free(R.tuples);
+}
+
+/**
+ * @brief Saves a filter, loads it again and compares the lookups of inserted
+ * and other keys. Loading it with other parameters or from a truncated file
+ * has to fail.
+ *
+ * @param seed seed for the keys and the filter
+ * @param n_samples number of keys to insert, as many others are probed
+ */
+void
+test_bloom_save_load(int seed, uint32_t n_samples)
+{
+    srand(seed);
+    relation_t R;
+    R.num_tuples = 2 * n_samples;
+    R.tuples     = malloc(R.num_tuples * sizeof(tuple_t));
+    random_unique_gen_range(&R, 0, 16 * R.num_tuples);
+
+    bloom_filter_args_t args;
+    test_filter_args(&args, BLOCKED, 1 << 20, 3);
+    bloom_filter_strategy_t * saved = bloom_filter_create(&args, rand());
+    for (uint32_t i = 0; i < n_samples; i++) {
+        saved->add(saved->filter, R.tuples[i].key);
+    }
+
+    char path[] = "/tmp/bloom_save_loadXXXXXX";
+    int  fd     = mkstemp(path);
+    assert(fd >= 0 && bloom_filter_save(saved, path) == 0,
+           "failed to save the filter to %s\n", path);
+    close(fd);
+
+    bloom_filter_strategy_t * loaded = bloom_filter_load(&args, path);
+    uint32_t                  differ = 0;
+    assert(loaded != NULL, "failed to load the saved filter\n");
+    for (uint32_t i = 0; loaded && i < R.num_tuples; i++) {
+        differ += saved->contains(saved->filter, R.tuples[i].key)
+                  != loaded->contains(loaded->filter, R.tuples[i].key);
+    }
+    assert(differ == 0, "loaded filter differs for %u of %lu keys\n", differ,
+           R.num_tuples);
+    if (loaded) bloom_filter_destroy(loaded);
+
+    /* the parameters and the size of the file are checked */
+    bloom_filter_args_t other = args;
+    other.k                   = args.k + 1;
+    loaded                    = bloom_filter_load(&other, path);
+    assert(loaded == NULL, "filter loaded with another k\n");
+    if (loaded) bloom_filter_destroy(loaded);
+    other   = args;
+    other.m = 2 * args.m;
+    loaded  = bloom_filter_load(&other, path);
+    assert(loaded == NULL, "filter loaded with another m\n");
+    if (loaded) bloom_filter_destroy(loaded);
+    /* half of the bitmap is cut off */
+    assert(truncate(path, 4096 + args.m / 16) == 0, "failed to truncate %s\n",
+           path);
+    loaded = bloom_filter_load(&args, path);
+    assert(loaded == NULL, "truncated filter loaded\n");
+    if (loaded) bloom_filter_destroy(loaded);
+
+    printf("save/load: %u of %lu lookups differ\n", differ, R.num_tuples);
+    unlink(path);
+    bloom_filter_destroy(saved);
+    free(R.tuples);
+}
+
+/**
+ * @brief Compares the sector masks and tests of the SIMD paths with a scalar
+ * reference that sets bit (h >> 6s) & 63 in each selected sector s per round.
+ * The blocks are random with a fill of about 7/8, so both outcomes of a test
+ * occur, and the reference mask is or-ed into every other block.
+ *
+ * @param seed seed for the keys, the blocks and the filter
+ * @param n_samples number of keys per k of 1 to 17
+ */
+void
+test_bloom_sectorized_simd(int seed, uint32_t n_samples)
+{
+    srand(seed);
+    bloom_filter_args_t args;
+    test_filter_args(&args, SECTORIZED, 1 << 20, 1);
+    bloom_filter_strategy_t * strategy = bloom_filter_create(&args, rand());
+    const bloom_filter_t *    filter   = strategy->filter;
+
+    uint64_t block[SECTORS_PER_BLOCK] __attribute__((aligned(CACHE_LINE_SIZE)));
+    uint64_t mask[SECTORS_PER_BLOCK];
+    uint64_t ref[SECTORS_PER_BLOCK];
+    uint64_t masks = 0, tests = 0, hits = 0;
+    for (uint64_t k = 1; k <= 2 * SECTORS_PER_BLOCK + 1; k++) {
+        for (uint32_t i = 0; i < n_samples; i++) {
+            const intkey_t key = (intkey_t) rand64();
+            uint64_t       h   = bloom_sectorized_hash(filter, key);
+            memset(ref, 0, sizeof(ref));
+            for (uint64_t r = 0; r < k; r += SECTORS_PER_BLOCK) {
+                const uint32_t sel = bloom_sectorized_select(h, k - r);
+                for (int s = 0; s < SECTORS_PER_BLOCK; s++) {
+                    if (sel >> s & 1) ref[s] |= 1ULL << ((h >> (6 * s)) & 63);
+                }
+                h = bloom_sectorized_rehash(h);
+            }
+
+            bloom_sectorized_mask(filter, key, k, mask);
+            masks += memcmp(mask, ref, sizeof(ref)) != 0;
+
+            bool expected = true;
+            for (int s = 0; s < SECTORS_PER_BLOCK; s++) {
+                block[s] = rand64() | rand64() | rand64();
+                if (i & 1) block[s] |= ref[s];
+                expected &= (block[s] & ref[s]) == ref[s];
+            }
+            tests += bloom_sectorized_test(filter, key, k, block) != expected;
+            hits += expected;
+        }
+    }
+    const uint64_t n = (2 * SECTORS_PER_BLOCK + 1) * (uint64_t) n_samples;
+    assert(masks == 0 && tests == 0,
+           "sectorized: %lu masks and %lu tests of %lu differ\n", masks, tests,
+           n);
+    printf("sectorized (%s): %lu masks and %lu tests of %lu differ, %lu hits\n",
+           SIMD_PATHS, masks, tests, n, hits);
+    bloom_filter_destroy(strategy);
+}
+
+/**
+ * @brief Compares the selection compaction of the SIMD paths with the selected
+ * tuples in order, for sizes that are not a multiple of 64 and selections from
+ * empty to full. The output is followed by a guard that must stay intact
+ * beyond the BLOOM_COMPACT_PADDING tuples.
+ *
+ * @param seed seed for the sizes and the selections
+ * @param n_samples number of selections to compact
+ */
+void
+test_bloom_selection_compact(int seed, uint32_t n_samples)
+{
+    const uint32_t n_max = 1000, guard = 16;
+    const double   fill[] = {0.0, 0.05, 0.5, 0.95, 1.0};
+    tuple_t *      tuples = malloc(n_max * sizeof(tuple_t));
+    tuple_t *      out = malloc((n_max + BLOOM_COMPACT_PADDING + guard)
+                                * sizeof(tuple_t));
+    uint64_t       sel[BLOOM_SEL_WORDS(n_max)];
+    uint32_t       differ = 0, overrun = 0;
+
+    srand(seed);
+    for (uint32_t i = 0; i < n_max; i++) {
+        tuples[i].key     = i + 1;
+        tuples[i].payload = rand();
+    }
+    for (uint32_t i = 0; i < n_samples; i++) {
+        const uint32_t n = 1 + rand() % n_max;
+        const double   p = fill[i % (sizeof(fill) / sizeof(fill[0]))];
+        uint32_t       expected = 0;
+        memset(sel, 0, sizeof(sel));
+        for (uint32_t j = 0; j < n; j++) {
+            if (rand() < p * ((double) RAND_MAX + 1)) {
+                sel[j >> 6] |= 1ULL << (j & 63);
+                expected++;
+            }
+        }
+        /* a key of 0 marks the guard, the tuples have keys from 1 */
+        memset(out, 0, (n_max + BLOOM_COMPACT_PADDING + guard) * sizeof(tuple_t));
+
+        const uint32_t count = bloom_selection_compact(tuples, n, sel, out);
+        uint32_t       pos   = 0;
+        bool           equal = count == expected;
+        for (uint32_t j = 0; equal && j < n; j++) {
+            if (sel[j >> 6] >> (j & 63) & 1) {
+                equal = out[pos].key == tuples[j].key
+                        && out[pos].payload == tuples[j].payload;
+                pos++;
+            }
+        }
+        differ += !equal;
+        for (uint32_t j = count + BLOOM_COMPACT_PADDING;
+             j < count + BLOOM_COMPACT_PADDING + guard; j++) {
+            overrun += out[j].key != 0;
+        }
+    }
+    assert(differ == 0 && overrun == 0,
+           "selection compaction: %u of %u differ, %u guard tuples written\n",
+           differ, n_samples, overrun);
+    printf("selection compaction (%s): %u of %u differ, %u guard tuples "
+           "written\n",
+           SIMD_PATHS, differ, n_samples, overrun);
+    free(out);
+    free(tuples);
+}
+
+/**
+ * @brief Joins --non-unique R and S with the tagged bucket chains of PROT and
+ * the plain ones of PRO, with and without a filter. All of them have to find
+ * the result count of a join of the key histograms. R has about 16 tuples
+ * per key, half of S joins with R and half is above its keys.
+ *
+ * @param seed seed for the relations and the filter
+ * @param n_samples number of R-tuples, S has 4 times as many
+ */
+void
+test_tagged_join(int seed, uint32_t n_samples)
+{
+    const int64_t maxid = n_samples / 16;
+    relation_t    R, S;
+    seed_generator(seed);
+    create_relation_nonunique(&R, n_samples, maxid);
+    create_relation_nonunique_from_pk(&S, &R, 4 * (int64_t) n_samples, maxid,
+                                      0.5);
+
+    uint32_t * hist     = calloc(maxid + 1, sizeof(uint32_t));
+    int64_t    expected = 0;
+    for (uint64_t i = 0; i < R.num_tuples; i++) {
+        hist[R.tuples[i].key]++;
+    }
+    for (uint64_t i = 0; i < S.num_tuples; i++) {
+        if (S.tuples[i].key <= (uint64_t) maxid) {
+            expected += hist[S.tuples[i].key];
+        }
+    }
+    free(hist);
+
+    bloom_filter_args_t args;
+    test_filter_args(&args, BLOCKED, 1 << 24, 2);
+
+    /* pass-2 uses the input relations as scratch, restore them for each join */
+    const size_t sizeR = R.num_tuples * sizeof(tuple_t);
+    const size_t sizeS = S.num_tuples * sizeof(tuple_t);
+    tuple_t *    copyR = malloc(sizeR);
+    tuple_t *    copyS = malloc(sizeS);
+    memcpy(copyR, R.tuples, sizeR);
+    memcpy(copyS, S.tuples, sizeS);
+
+    const char * names[] = {"PRO", "PROT", "PRO (filter)", "PROT (filter)"};
+    int64_t      results[4];
+    for (int a = 0; a < 4; a++) {
+        memcpy(R.tuples, copyR, sizeR);
+        memcpy(S.tuples, copyS, sizeS);
+        result_t * res = a == 0   ? PRO(&R, &S, 2)
+                         : a == 1 ? PROT(&R, &S, 2)
+                         : a == 2 ? BPRO(&R, &S, 2, &args)
+                                  : BPROT(&R, &S, 2, &args);
+        results[a]     = res->totalresults;
+        assert(results[a] == expected, "%s found %ld instead of %ld results\n",
+               names[a], results[a], expected);
+#ifdef JOIN_RESULT_MATERIALIZE
+        free(res->resultlist);
+#endif
+        free(res);
+    }
+    printf("tagged join: PRO %ld, PROT %ld, with filter %ld and %ld of %ld "
+           "results\n",
+           results[0], results[1], results[2], results[3], expected);
+
+    free(copyS);
+    free(copyR);
+    delete_relation(&S);
+    delete_relation(&R);
+}
+
+/**
+ * @brief Initializes an exact filter over a narrow key range, which has to
+ * find exactly the inserted keys, and over the full key range, which cannot
+ * be covered by one bit per key and has to fall back to a blocked filter
+ * that still finds all inserted keys.
+ *
+ * @param seed seed for the keys and the filter
+ * @param n_samples number of keys to insert
+ */
+void
+test_bloom_exact_range(int seed, uint32_t n_samples)
+{
+    const intkey_t lowest  = (intkey_t) 1 << (sizeof(intkey_t) * 8 - 1);
+    const intkey_t highest = ~lowest;
+    const intkey_t min     = -(intkey_t) n_samples;
+    uint32_t       errors  = 0;
+
+    srand(seed);
+    bloom_filter_args_t args;
+    test_filter_args(&args, EXACT, 4 * (uint64_t) n_samples, 2);
+    for (int full = 0; full < 2; full++) {
+        bloom_filter_strategy_t * strategy = bloom_filter_create(&args, rand());
+        const bool exact = bloom_filter_exact_init(
+            strategy, full ? lowest : min, full ? highest : min + 2 * n_samples);
+        assert(exact != full, "exact filter over the %s range is %s\n",
+               full ? "full" : "narrow", exact ? "exact" : "blocked");
+        errors += exact == full;
+        /* every other key of the narrow range */
+        for (uint32_t i = 0; i < n_samples; i++) {
+            strategy->add(strategy->filter, min + 2 * (intkey_t) i);
+        }
+        for (uint32_t i = 0; i < 2 * n_samples; i++) {
+            const bool found = strategy->contains(strategy->filter,
+                                                  min + (intkey_t) i);
+            /* only the exact filter has no false positives */
+            errors += i % 2 == 0 ? !found : exact && found;
+        }
+        bloom_filter_destroy(strategy);
+    }
+    assert(errors == 0, "exact range: %u errors\n", errors);
+    printf("exact range: %u errors in %u lookups\n", errors, 4 * n_samples);
+}
+
 /**
  * @brief Parses the input arguments and executes the unit-test-like tests
  * The parameters need to be provided in order but can be left out to use
  * default values Specifying "later" parameters need all preceeding ones to be
  * specified. The parameters are:
- * 1. Test index: 0=test_hash, 1=test_enhanced_double_hashing, 2=test_bloom_fpr
+ * 1. Test index: 0=test_hash, 1=test_enhanced_double_hashing, 2=test_bloom_fpr,
+ *    3=test_coalesced_join, 4=test_bloom_save_load,
+ *    5=test_bloom_sectorized_simd, 6=test_bloom_selection_compact,
+ *    7=test_tagged_join, 8=test_bloom_exact_range
  * 2. seed: for random values
  * 3. n_samples: Number of samples for testing
  *
@@ -338,6 +885,24 @@ main(int argc, char ** argv)
         case 2:
             test_bloom_fpr_wrapper(seed, m, k_max, n_samples, n_insertions);
             break;
+        case 3:
+            test_coalesced_join(seed);
+            break;
+        case 4:
+            test_bloom_save_load(seed, n_samples);
+            break;
+        case 5:
+            test_bloom_sectorized_simd(seed, n_samples);
+            break;
+        case 6:
+            test_bloom_selection_compact(seed, n_samples);
+            break;
+        case 7:
+            test_tagged_join(seed, n_samples);
+            break;
+        case 8:
+            test_bloom_exact_range(seed, n_samples);
+            break;
         default:
             break;
     }